@@ -0,0 +1,12 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "TerrainMap.h"
+
+// Benchmarks run from the Settings panel. They trace rays through the current view of the map
+// and print their timings to stdout, like the chunk load timings.
+
+// Picks a raysPerSide x raysPerSide grid of screen points four ways: every chunk with the plain
+// cell-by-cell DDA walk, every chunk with the min/max pyramid, TerrainMap::raycast one ray at a
+// time, and TerrainMap::raycastBatch. Reports time, rays/second, chunks stepped, node visits and
+// cells tested for each.
+void runPickingBenchmark(TerrainMap& map, const glm::mat4& invVP, int raysPerSide=64);
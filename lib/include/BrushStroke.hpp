@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "TerrainChunk.hpp"
+
+// Turns the per-frame cursor hits of a held mouse button into brush dabs.
+//
+// Dabs are laid along the path between successive hits every Brush::spacing*radius, so fast
+// mouse motion no longer leaves gaps. Each frame deposits dt*kReferenceRate dabs' worth of
+// strength, split evenly over the dabs it produced, so a stroke builds up at the same speed
+// at 60 Hz and at 240 Hz. At exactly 60 Hz a stationary cursor gives one dab of weight 1,
+// which is what the old once-per-frame brush did.
+class BrushStroke {
+    public:
+        static constexpr float kReferenceRate = 60.0f; // frames/s the brush strength was tuned at
+        static constexpr float kMaxFrameTime  = 0.1f;  // longer hitches don't dump a huge dab
+        static constexpr int   kMaxDabs       = 256;   // per frame; spacing widens past this
+
+        // Appends this frame's dabs to outDabs and returns the weight of each one
+        float update(const glm::vec3& hit, float dt, const Brush& b, std::vector<glm::vec3>& outDabs);
+        void end() { active = false; }
+        bool isActive() const { return active; }
+
+    private:
+        bool active = false;
+        glm::vec3 lastDab{0.0f};
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad/glad.h"
+#include <Shader.hpp>
+#include "Frustum.hpp"
+
+class TerrainMap;
+class TerrainChunk;
+struct DirtyRect;
+
+// Counters from the last CdlodRenderer::select/render, shown in the Settings panel
+struct CdlodStats {
+    int nodesVisited = 0;       // quadtree nodes tested during selection
+    int nodesDrawn = 0;         // selected nodes, one draw call each
+    int nodesCulled = 0;        // nodes rejected by the frustum, subtree included
+    long long triangles = 0;
+    double selectMs = 0.0;
+    int residentChunks = 0;     // chunks with a full-resolution layer
+    int missingChunks = 0;      // needed full resolution but found no free layer
+    int farShift = 0;           // the far copy keeps every 2^farShift-th sample
+};
+
+// Continuous distance-based LOD (Strugar's CDLOD) over a whole TerrainMap.
+//
+// A quadtree covers the map in sample space. Every node is drawn with the same gridDim x gridDim
+// mesh scaled to the node, so a level-l node places a vertex every 2^l samples. Nodes are chosen
+// by distance rings that double per level. Near the outer edge of its ring a node's odd vertices
+// morph onto the parent lattice, so levels blend without popping or cracks.
+//
+// Heights live in two places, so GPU memory doesn't grow with full-resolution chunk count:
+//  - a "far" R32F copy of the whole map keeping every 2^farShift-th sample, with farShift picked so
+//    it fits kFarMaxSize. A level >= farShift node only has vertices on that lattice, so it reads
+//    exact heights from it.
+//  - a small texture array of full-resolution chunk layers, paged in (LRU) for the chunks under
+//    the selected nodes finer than farShift. A chunk without a layer falls back to the far copy.
+// Both are kept in sync from the chunks' height edits.
+class CdlodRenderer {
+    public:
+        explicit CdlodRenderer(int gridDim = 32);
+        ~CdlodRenderer();
+
+        // Uploads chunk edits since the last call (everything after the map was resized or reloaded)
+        void sync(TerrainMap& map);
+        // Picks the nodes to draw for a camera at camPos; detailDistance is the radius of level 0.
+        // With a frustum, nodes outside it are dropped together with their subtree.
+        void select(TerrainMap& map, const glm::vec3& camPos, float detailDistance, const Frustum* frustum=nullptr);
+        // Draws the selected nodes; shader is a cdlod.vs permutation and must already be bound
+        void render(Shader& shader);
+
+        const CdlodStats& stats() const { return lastStats; }
+
+    private:
+        struct Node { int level, x, z, quadMask; };  // quadMask bit q = child (q&1, q>>1) drawn here
+
+        int gridDim;
+        GLuint vao = 0, ibo = 0;
+        GLsizei quadCount = 0;                        // indices per mesh quadrant
+
+        GLuint heightArray = 0;                       // resident full-resolution chunk layers
+        GLuint layerTable = 0;                        // R32I per chunk: its layer, -1 if not resident
+        GLuint farHeights = 0;                        // every 2^farShift-th sample of the whole map
+        int layersX = 0, layersZ = 0, layerSize = 0;  // map layout the textures were made for
+        int farShift = 0, farW = 0, farH = 0;
+        int layerCapacity = 0;
+        std::vector<int> chunkLayer;                  // per grid cell
+        std::vector<int> layerChunk;                  // per layer: grid cell, -1 if free
+        std::vector<unsigned> layerUsed;              // frame stamp of the last select that needed it
+        std::vector<unsigned> chunkStamp;             // per grid cell, dedupes the needed list
+        std::vector<int> needed;                      // scratch for updateResidency
+        std::vector<float> uploadScratch;
+        unsigned frameStamp = 0;
+        bool reportedShortage = false;                // layer shortage is reported once per layout
+        bool storageFailed = false;                   // allocate failed for the current layout
+
+        // Map layout as of the last select
+        int chunkCells = 0;
+        int worldCellsX = 0, worldCellsZ = 0;
+        float cellSize = 1.0f;
+
+        std::vector<float> ranges;                    // LOD ring radius per level
+        std::vector<Node> selected;
+        const Frustum* cullFrustum = nullptr;         // for the select in progress
+        CdlodStats lastStats;
+
+        void buildMesh();
+        bool allocate(int chunksX, int chunksZ, int size);
+        void uploadFar(const TerrainChunk& chunk, const DirtyRect& r);
+        void uploadLayer(const TerrainChunk& chunk, int layer, const DirtyRect& r);
+        void updateResidency(TerrainMap& map);
+        bool selectNode(TerrainMap& map, int level, int x, int z, const glm::vec3& camPos);
+        void nodeBounds(TerrainMap& map, int level, int x, int z, glm::vec3& bmin, glm::vec3& bmax) const;
+        void drawSelected(Shader& shader);
+};
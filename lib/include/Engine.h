@@ -13,8 +13,14 @@
 #include <limits>
 #include <cmath>
 #include <Shader.hpp>
+#include <ShaderVariants.hpp>
+#include "FrameUniforms.hpp"
+#include "RenderTarget.hpp"
 #include "TerrainChunk.hpp"
 #include "TerrainMap.h"
+#include "CdlodRenderer.hpp"
+#include "BrushStroke.hpp"
+#include "Benchmark.h"
 #include "Camera.hpp"
 //ImGui + SDL
 #include <SDL2/SDL.h>
@@ -34,28 +40,23 @@ class Engine {
     private:
         
         Camera cam;
-        void buildCircle(std::vector<glm::vec3>& out, float radius, int segments=64);
-        void GenCircleGL();
         void HandleInput(float dt);
-        void CreateFrameBuffer();
-        void RescaleFramebuffer(float width, float height);
-        void BindFramebuffer();
-        void UnbindFramebuffer();
         ImVec2 RenderGUI();
-        Shader* heightMapShader;
-        Shader* heightMapColorShader;
+        ShaderVariants* terrainShaders;         // hmap.vs/hmap.fs(/hmap.g) permutations
+        ShaderVariants* cdlodShaders;           // cdlod.vs with the same fragment/geometry stages
+        FrameUniforms frameUniforms;            // std140 FrameData block shared by the terrain programs
         // TerrainChunk* terrainChunk;
         TerrainMap* terrainMap;
+        CdlodRenderer* cdlod;
         Brush brush;
+        BrushStroke stroke;
+        std::vector<glm::vec3> strokeDabs;
 
         int ScreenWidth=1920;
         int ScreenHeight=1080;
         SDL_Window* win;
         SDL_GLContext glctx;
 
-        GLuint ringVBO=0;
-        GLuint ringVAO=0;
-        std::vector<glm::vec3> ringVerts;
         
         bool running=true;
         float aspect=ScreenWidth/ScreenHeight;
@@ -65,7 +66,12 @@ class Engine {
         bool mmb=false; 
         bool shift=false;
         bool flatshade=false;
-        bool projectCircle=true;
+        bool runPickBenchmark=false;
+        bool useLod=true;
+        float lodPixelError=1.0f;              // geomipmap screen-space error budget in pixels
+        bool useFrustumCulling=true;
+        bool useCdlod=false;                   // draw through CdlodRenderer instead of TerrainMap::render
+        float cdlodDetailDistance=150.0f;      // radius of the full-resolution CDLOD ring
         float EditorWindowWidth;
         float EditorWindowHeight;
 
@@ -75,9 +81,9 @@ class Engine {
         const float TILE_SIZE   = 533.333f;     // WoW ADT ~533.333m, optional
         const float CELL_SIZE   = TILE_SIZE / (GRID_SIZE - 1);
 
-        GLuint FBO = 0;
-        GLuint texture_id = 0;
-        GLuint RBO = 0;
+        RenderTarget viewportTarget;            // editor viewport, sized to the panel
+        DynamicResolution dynRes;
+        int renderWidth = 1, renderHeight = 1;  // pixels actually rendered this frame
 
 };
 
@@ -0,0 +1,64 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <Shader.hpp>
+
+// Per-frame constants shared by every terrain/overlay program, laid out like the std140 FrameData
+// block in kFrameDataGlsl below. std140 stores a mat3 as three vec4 columns and pads vec3 to vec4,
+// so those members are spelled out with their padding here.
+struct FrameData {
+    glm::mat4 viewProj;
+    glm::mat4 mvp;
+    glm::mat4 model;
+    glm::vec4 nrmM[3];       // mat3 columns, w unused
+    glm::vec4 camPos;        // xyz
+    glm::vec4 lightDir;      // xyz, normalised
+    glm::vec4 brush;         // cursor decal: xyz hit, w radius (0 = no cursor)
+    glm::vec4 brushParams;   // x falloff on, y mode, z lowering
+
+    void setNormalMatrix(const glm::mat3& m) { for(int i = 0; i < 3; ++i) nrmM[i] = glm::vec4(m[i], 0.0f); }
+    // radius 0 hides the cursor; mode is the BrushMode value
+    void setBrush(const glm::vec3& hit, float radius, bool falloff, int mode, bool lower)
+    {
+        brush = glm::vec4(hit, radius);
+        brushParams = glm::vec4(falloff ? 1.0f : 0.0f, (float)mode, lower ? 1.0f : 0.0f, 0.0f);
+    }
+};
+static_assert(sizeof(FrameData) == 3*64 + 48 + 4*16, "FrameData must match the std140 layout");
+
+// The GLSL side of FrameData. ShaderVariants injects it into every stage, so it only has to be
+// kept in step with the struct above, here.
+static const char* const kFrameDataGlsl =
+    "layout(std140) uniform FrameData {\n"
+    "    mat4 uViewProj;\n"
+    "    mat4 uMVP;\n"
+    "    mat4 uModel;\n"
+    "    mat3 uNrmM;\n"
+    "    vec4 uCamPos;       // xyz\n"
+    "    vec4 uLightDir;     // xyz, normalised\n"
+    "    vec4 uBrush;        // brush cursor: xyz hit, w radius (0 = hidden)\n"
+    "    vec4 uBrushParams;  // x falloff on, y mode (0 raise/lower, 1 smooth, 2 flat), z lowering\n"
+    "};\n";
+
+// The uniform buffer behind FrameData: one upload per frame, bound at kFrameDataBinding, which
+// Shader wires every program's FrameData block to when it links.
+class FrameUniforms {
+    public:
+        ~FrameUniforms(){ if(ubo) glDeleteBuffers(1, &ubo); }
+
+        void upload(const FrameData& data)
+        {
+            if(!ubo) {
+                glGenBuffers(1, &ubo);
+                glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+                glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+                glBindBufferBase(GL_UNIFORM_BUFFER, kFrameDataBinding, ubo);
+            }
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+    private:
+        GLuint ubo = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// View frustum as six inward-facing planes (ax+by+cz+d >= 0 inside), pulled straight out of a
+// projection*view matrix (Gribb/Hartmann), so it works for any matrix the camera hands out.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProj) { extract(viewProj); }
+
+    void extract(const glm::mat4& m)
+    {
+        // glm is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 r0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 r1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 r2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 r3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[0] = r3 + r0;  // left
+        planes[1] = r3 - r0;  // right
+        planes[2] = r3 + r1;  // bottom
+        planes[3] = r3 - r1;  // top
+        planes[4] = r3 + r2;  // near
+        planes[5] = r3 - r2;  // far
+    }
+
+    // Conservative box test: false only if the box lies fully outside one plane. Boxes near a
+    // frustum corner can pass while still being invisible, which only costs a draw.
+    bool intersectsBox(const glm::vec3& bmin, const glm::vec3& bmax) const
+    {
+        for(const glm::vec4& p : planes){
+            // Box corner furthest along the plane normal
+            glm::vec3 v(p.x >= 0.0f ? bmax.x : bmin.x,
+                        p.y >= 0.0f ? bmax.y : bmin.y,
+                        p.z >= 0.0f ? bmax.z : bmin.z);
+            if(p.x*v.x + p.y*v.y + p.z*v.z + p.w < 0.0f) return false;
+        }
+        return true;
+    }
+};
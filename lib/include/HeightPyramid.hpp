@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <glm/glm.hpp>
+
+struct HeightMap;
+
+// Optional counters filled in by the pickers, used by the picking benchmark
+struct PickStats {
+    long long chunksVisited = 0;  // chunks TerrainMap::raycast stepped through
+    long long nodesVisited = 0;   // pyramid nodes whose box was tested
+    long long cellsTested  = 0;   // cells whose two triangles were intersected
+};
+
+// Slab test of ro + rd*t against an axis-aligned box; on a hit returns the entry/exit
+// interval clipped to [t0,t1]. invRd is 1/rd per component (infinities are fine).
+bool rayBox(const glm::vec3& ro, const glm::vec3& invRd, const glm::vec3& bmin, const glm::vec3& bmax,
+            float t0, float t1, float& tEnter, float& tExit);
+
+// Four rays in SoA layout for the packet slab test; inv* hold 1/rd per component
+struct RayPacket4 {
+    float ox[4], oy[4], oz[4];
+    float ix[4], iy[4], iz[4];
+};
+
+// rayBox for four rays at once (SSE2 where available). Returns a bitmask of the lanes that
+// hit; tEnter/tExit are only meaningful for those lanes.
+int rayBox4(const RayPacket4& p, const glm::vec3& bmin, const glm::vec3& bmax,
+            float t0, float t1, float tEnter[4], float tExit[4]);
+
+// Exact intersection of ro + rd*t, t in [tMin,tMax], with cell (cx,cz) of hm. The cell is split
+// into the same two triangles the mesh index buffer draws, so the hit lies on the rendered surface.
+bool rayCellIntersect(const HeightMap& hm, int cx, int cz, const glm::vec3& ro, const glm::vec3& rd,
+                      float tMin, float tMax, float& tHit);
+
+// Min/max quadtree over the cells of a HeightMap.
+//
+// Level 0 holds the min/max of the four corner samples of every cell, each level above halves
+// the resolution until a single root node covers the whole chunk. Ray picking walks it top-down,
+// skipping every node whose box the ray misses, so a pick visits O(log n) nodes plus the handful
+// of cells near the hit instead of walking every cell along the ray.
+//
+// A pyramid can also start from a summary (the coarse levels and LOD errors saved with an HMP2
+// file). The fine levels are then built from hm the first time a query or edit reaches them, so
+// loading a chunk doesn't read its samples.
+class HeightPyramid {
+    public:
+        void build(const HeightMap& hm);
+        // Packs the LOD errors and as many of the coarsest levels as fit into capacity bytes;
+        // returns the bytes written, 0 if not even the root fits
+        size_t writeSummary(void* dst, size_t capacity) const;
+        // Takes a writeSummary blob for hm instead of building; hm must stay alive and unchanged
+        // except through update(). Returns false (and leaves the pyramid alone) if it doesn't fit hm.
+        bool readSummary(const HeightMap& hm, const void* src, size_t bytes);
+        // Refreshes the nodes covering the sample rectangle [x0,x1]x[z0,z1] after an edit
+        void update(const HeightMap& hm, int x0, int z0, int x1, int z1);
+
+        float minHeight() const { return levels.empty() ? 0.0f : levels.back().minH[0]; }
+        float maxHeight() const { return levels.empty() ? 0.0f : levels.back().maxH[0]; }
+
+        // Min/max over the cell rectangle [x0,x1]x[z0,z1] (inclusive, clamped to the chunk); lo/hi are
+        // only widened, so several chunks can be folded into one range. Returns false if it's empty.
+        bool rangeMinMax(int x0, int z0, int x1, int z1, float& lo, float& hi) const;
+
+        // Geomipmap levels the pyramid tracks errors for: level l draws every 2^l-th sample
+        static constexpr int kLodLevels = 4;
+        // Largest vertical distance between the full-res surface and the level-l mesh (0 for l=0).
+        // Level l nodes are exactly the level-l lattice quads, so each node keeps its own error and
+        // edits only recompute the nodes they touch. Non-decreasing in l.
+        float lodError(int l) const { return lodErr[std::min(std::max(l, 0), kLodLevels - 1)]; }
+
+        // Nearest hit along ro + rd*t for t in [0,maxDist], all in chunk-local space
+        bool raycast(const HeightMap& hm, const glm::vec3& ro, const glm::vec3& rd, float maxDist,
+                     float& tHit, PickStats* stats=nullptr) const;
+
+    private:
+        struct Level {
+            int w = 0, h = 0;             // nodes per side
+            std::vector<float> minH, maxH;
+            std::vector<float> errH;      // levels 1..kLodLevels-1 only, see lodError
+        };
+        // Levels below firstStored are filled by completeLevels() on first use, so const queries
+        // may write them (under completeLock)
+        mutable std::vector<Level> levels; // levels[0] = per cell, levels.back() = root
+        int cells = 0;                    // cells per side (hm.size-1)
+        int firstStored = 0;              // lowest level that is filled in
+        const HeightMap* lazySource = nullptr;
+        mutable std::atomic<bool> incomplete{false};
+        mutable std::mutex completeLock;  // queries may run on several picking threads at once
+
+        float lodErr[kLodLevels] = {};
+
+        static std::vector<Level> makeLevels(int cells);
+        // Before touching level l: fills the missing levels if l is one of them
+        void need(int l) const { if(l < firstStored && incomplete.load(std::memory_order_acquire)) completeLevels(); }
+        void completeLevels() const;
+        void refreshLevel(int l, int x0, int z0, int x1, int z1) const;
+        void rangeNode(int l, int x, int z, int x0, int z0, int x1, int z1, float& lo, float& hi) const;
+        void refreshError(const HeightMap& hm, int l, int x0, int z0, int x1, int z1) const;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// A whole file mapped copy-on-write (MAP_PRIVATE / FILE_MAP_COPY). The pages can be written, but
+// writes stay private to this process and never reach the file; untouched pages stay shared with
+// the page cache and are only faulted in when first read.
+class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile(){ close(); }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+
+        unsigned char* data() const { return base; }
+        size_t size() const { return bytes; }
+
+    private:
+        unsigned char* base = nullptr;
+        size_t bytes = 0;
+};
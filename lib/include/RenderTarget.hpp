@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+
+// Offscreen colour + depth/stencil target for the editor viewport. resize() only touches the GL
+// storage when the size actually changes, so it can be called every frame with the window size.
+class RenderTarget {
+    public:
+        ~RenderTarget(){ destroy(); }
+
+        // Returns true if the attachments were (re)allocated
+        bool resize(int w, int h);
+        void destroy();
+
+        // Binds the FBO with a renderW x renderH viewport in its bottom-left corner, which may be
+        // smaller than the allocated size (dynamic resolution)
+        void bind(int renderW, int renderH) const;
+        static void unbind();
+
+        GLuint colorTexture() const { return color; }
+        int width() const { return w; }
+        int height() const { return h; }
+
+    private:
+        GLuint fbo = 0, color = 0, depth = 0;
+        int w = 0, h = 0;
+};
+
+// Picks a render scale for the viewport against a GPU frame-time budget. The terrain pass is
+// timed with GL_TIME_ELAPSED queries read a few frames late (never stalling on the GPU); since
+// pixel cost grows with scale^2 the correction is the square root of budget/time, damped, with a
+// dead band so the scale doesn't shimmer. Rendering goes into a scale-sized corner of the full
+// RenderTarget and is stretched back when composited, so changing the scale reallocates nothing.
+class DynamicResolution {
+    public:
+        ~DynamicResolution();
+
+        bool enabled = false;
+        float budgetMs = 12.0f;
+        float minScale = 0.5f;
+
+        void beginFrame();
+        void endFrame();
+
+        float scale() const { return enabled ? current : 1.0f; }
+        float lastGpuMs() const { return gpuMs; }
+
+    private:
+        static const int kQueries = 4;
+        GLuint queries[kQueries] = {};
+        bool pending[kQueries] = {};
+        int next = 0;
+        bool timing = false;                // a query is open for the current frame
+        float gpuMs = 0.0f;
+        float current = 1.0f;
+
+        void adjust(float ms);
+};
@@ -4,21 +4,31 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Binding point of the std140 FrameData block (see FrameUniforms.hpp); every program that
+// declares the block gets it bound here when it links
+static const GLuint kFrameDataBinding = 0;
+
 class Shader
 {
 public:
     unsigned int ID;
 
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly; defines ("#define X\n" lines, or any
+    // other declarations every stage needs) are inserted right after the #version line of every stage
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
-           const char* tessControlPath = nullptr, const char* tessEvalPath = nullptr)
+           const char* tessControlPath = nullptr, const char* tessEvalPath = nullptr,
+           const std::string& defines = std::string())
     {
+        m_Defines = defines;
         // Save paths if you want reload() without parameters later
         m_VertexPath = vertexPath;
         m_FragmentPath = fragmentPath;
@@ -35,6 +45,19 @@ public:
         loadShader();        // reload from saved paths
     }
 
+    // Uniform location from the table built at link time; the name is hashed (FNV-1a) and
+    // compared, so the render loop never asks the driver. Unknown names fall back to
+    // glGetUniformLocation once and are remembered (usually as -1).
+    GLint location(const std::string &name) const
+    {
+        uint32_t h = hashName(name);
+        auto it = m_Locations.find(h);
+        if (it != m_Locations.end() && it->second.name == name) return it->second.location;
+        GLint loc = glGetUniformLocation(ID, name.c_str());
+        if (it == m_Locations.end()) m_Locations.emplace(h, UniformSlot{name, loc});
+        return loc;
+    }
+
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
@@ -45,59 +68,59 @@ public:
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(location(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(location(name), 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(location(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(location(name), 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(location(name), 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
@@ -107,6 +130,62 @@ private:
     const char* m_GeometryPath;
     const char* m_TessControlPath;
     const char* m_TessEvalPath;
+    std::string m_Defines;
+
+    struct UniformSlot { std::string name; GLint location; };
+    mutable std::unordered_map<uint32_t, UniformSlot> m_Locations;
+
+    static uint32_t hashName(const std::string &name)
+    {
+        uint32_t h = 2166136261u;
+        for (unsigned char c : name) { h ^= c; h *= 16777619u; }
+        return h;
+    }
+
+    // Active uniforms after a successful link; arrays are registered as both "a" and "a[0]"
+    void cacheUniforms()
+    {
+        m_Locations.clear();
+        GLint count = 0, maxLen = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
+        std::string buf(std::max(maxLen, 1), '\0');
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei len = 0; GLint size = 0; GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buf.size(), &len, &size, &type, &buf[0]);
+            std::string name(buf.data(), len);
+            GLint loc = glGetUniformLocation(ID, name.c_str());
+            if (loc < 0) continue;  // block members have no location
+            addLocation(name, loc);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                addLocation(name.substr(0, name.size() - 3), loc);
+        }
+
+        GLuint block = glGetUniformBlockIndex(ID, "FrameData");
+        if (block != GL_INVALID_INDEX) glUniformBlockBinding(ID, block, kFrameDataBinding);
+    }
+
+    void addLocation(const std::string &name, GLint loc)
+    {
+        auto res = m_Locations.emplace(hashName(name), UniformSlot{name, loc});
+        // A colliding second name just takes the glGetUniformLocation path in location()
+        if (!res.second && res.first->second.name != name)
+            std::cerr << "Shader: uniform hash collision between " << res.first->second.name << " and " << name << std::endl;
+    }
+
+    // #version has to stay the first statement, so the defines go after it; #line keeps
+    // compiler messages pointing at the lines of the file on disk
+    void injectDefines(std::string& code) const
+    {
+        if (m_Defines.empty() || code.empty()) return;
+        size_t version = code.find("#version");
+        size_t at = version == std::string::npos ? 0 : code.find('\n', version);
+        if (at == std::string::npos) { code += '\n'; at = code.size() - 1; }
+        if (version == std::string::npos) { code.insert(0, m_Defines + "#line 1\n"); return; }
+        int line = 1 + (int)std::count(code.begin(), code.begin() + at, '\n') + 1;
+        code.insert(at + 1, m_Defines + "#line " + std::to_string(line) + "\n");
+    }
 
     void loadShader()
     {
@@ -167,6 +246,12 @@ private:
             return;
         }
 
+        injectDefines(vertexCode);
+        injectDefines(fragmentCode);
+        injectDefines(geometryCode);
+        injectDefines(tessControlCode);
+        injectDefines(tessEvalCode);
+
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
 
@@ -220,6 +305,7 @@ private:
 
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniforms();
 
         glDeleteShader(vertex);
         glDeleteShader(fragment);
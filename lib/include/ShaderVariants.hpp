@@ -0,0 +1,69 @@
+#ifndef SHADER_VARIANTS_HPP
+#define SHADER_VARIANTS_HPP
+
+#include <Shader.hpp>
+#include "FrameUniforms.hpp"
+#include <map>
+#include <memory>
+#include <string>
+
+// Compile-time permutations of one VS/FS(/GS) shader family. Each feature combination becomes a
+// set of #defines, is compiled the first time it's asked for and cached after that. The geometry
+// stage is only linked into combinations that need it (Wireframe), so the common smooth/flat
+// paths are a plain VS+FS program. Every stage also gets the FrameData block declaration
+// (kFrameDataGlsl) after the defines.
+class ShaderVariants
+{
+public:
+    enum Feature : unsigned
+    {
+        FlatShading   = 1 << 0,  // FLAT_SHADING: derivative face normals in the fragment shader
+        Wireframe     = 1 << 1,  // WIREFRAME: barycentric edge overlay, needs the geometry stage
+        CompactVertex = 1 << 2,  // COMPACT_VERTEX: 8-byte terrain vertices
+        HeightTexture = 1 << 3,  // HEIGHT_TEXTURE: attribute-less terrain from the height array
+    };
+
+    // baseDefines go into every permutation, e.g. to tell shared stages which family they're in
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+                   const std::string& baseDefines = std::string())
+        : m_VertexPath(vertexPath), m_FragmentPath(fragmentPath), m_GeometryPath(geometryPath ? geometryPath : ""),
+          m_BaseDefines(baseDefines)
+    {
+    }
+
+    Shader& get(unsigned features)
+    {
+        auto it = m_Cache.find(features);
+        if (it != m_Cache.end()) return *it->second;
+
+        std::string defines = m_BaseDefines;
+        if (features & FlatShading)   defines += "#define FLAT_SHADING\n";
+        if (features & Wireframe)     defines += "#define WIREFRAME\n";
+        if (features & CompactVertex) defines += "#define COMPACT_VERTEX\n";
+        if (features & HeightTexture) defines += "#define HEIGHT_TEXTURE\n";
+        defines += kFrameDataGlsl;
+
+        const char* geometry = (features & Wireframe) && !m_GeometryPath.empty() ? m_GeometryPath.c_str() : nullptr;
+        auto shader = std::make_unique<Shader>(m_VertexPath.c_str(), m_FragmentPath.c_str(), geometry,
+                                               nullptr, nullptr, defines);
+        Shader& ref = *shader;
+        m_Cache.emplace(features, std::move(shader));
+        return ref;
+    }
+
+    // Recompiles every cached permutation from disk
+    void reloadAll()
+    {
+        for (auto& entry : m_Cache) entry.second->reload();
+    }
+
+    size_t compiledCount() const { return m_Cache.size(); }
+
+private:
+    std::string m_VertexPath;
+    std::string m_FragmentPath;
+    std::string m_GeometryPath;
+    std::string m_BaseDefines;
+    std::map<unsigned, std::unique_ptr<Shader>> m_Cache;
+};
+#endif
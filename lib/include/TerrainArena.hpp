@@ -0,0 +1,61 @@
+#pragma once
+#include "glad/glad.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TerrainIndexBuffer;
+
+struct VertexPNUV {
+    glm::vec3 p, n;
+    glm::vec2 uv;
+};
+
+// Packed vertex: X/Z/UV are implied by the grid index and chunk origin, so hmap.vs (COMPACT_VERTEX)
+// rebuilds them from gl_VertexID and only height and normal are stored.
+struct VertexCompact {
+    float h;
+    int16_t n[2];   // octahedron-encoded normal, snorm16
+};
+static_assert(sizeof(VertexCompact) == 8, "VertexCompact must stay 8 bytes");
+
+// How chunk geometry reaches the GPU.
+// FullVertex/CompactVertex keep vertices rebuilt from hm on edits; HeightTexture keeps no vertex data
+// at all, hmap.vs (HEIGHT_TEXTURE) displaces the shared index grid from an R32F copy of hm instead.
+enum class TerrainRenderMode { FullVertex, CompactVertex, HeightTexture };
+
+// GPU storage for every chunk of a TerrainMap in one place: one VBO (or one R32F texture array in
+// HeightTexture mode) split into fixed slots of gridSize^2 vertices, and one VAO over it and the
+// shared index buffer. Slot s starts at vertex s*gridSize^2, so a chunk is drawn by offsetting the
+// shared indices with baseVertex and the whole map goes out as a single glMultiDrawElementsBaseVertex.
+// gl_VertexID includes baseVertex, which is how the compact/texture shaders find a vertex's slot.
+class TerrainArena {
+    public:
+        ~TerrainArena(){ destroy(); }
+
+        // (Re)allocates for slotCount chunks; contents are undefined until the chunks upload
+        bool build(int slotCount, int gridSize, TerrainRenderMode mode, const TerrainIndexBuffer& indices);
+        void destroy();
+
+        TerrainRenderMode mode() const { return renderMode; }
+        GLint baseVertex(int slot) const { return slot * slotVerts; }
+
+        // Vertices [firstVertex, firstVertex+count) of a slot, Full/Compact modes
+        void uploadVertices(int slot, size_t firstVertex, const void* data, size_t bytes);
+        // Height rect of a slot's layer, HeightTexture mode; src strides rowLength floats per row
+        void uploadHeights(int slot, int x, int z, int w, int h, const float* src, int rowLength);
+
+        // One multi-draw over the queued ranges; counts/offsets/baseVertices are parallel arrays
+        void draw(const std::vector<GLsizei>& counts, const std::vector<const void*>& offsets,
+                  const std::vector<GLint>& baseVertices) const;
+
+    private:
+        GLuint vao = 0, vbo = 0;
+        GLuint heightArray = 0;                  // HeightTexture mode only, one layer per slot
+        TerrainRenderMode renderMode = TerrainRenderMode::FullVertex;
+        int slots = 0;
+        int slotVerts = 0;
+        int size = 0;
+        size_t vertexSize = 0;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include "glad/glad.h"
 #include <cmath>
@@ -8,23 +9,49 @@
 #include <iostream>
 #include <limits>
 #include <cmath>
-
-struct VertexPNUV {
-    glm::vec3 p, n;
-    glm::vec2 uv;
-};
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "HeightPyramid.hpp"
+#include "TerrainIndexBuffer.hpp"
+#include "TerrainArena.hpp"
+#include "MappedFile.hpp"
 
 struct HeightMap {
             int size;
             float cell;
-            std::vector<float> h;
-
-            HeightMap(int s, float c) : size(s), cell(c), h(s*s, 0.0f) {}
-
-            float& at(int x,int z){ return h[z*size + x]; }
-            float  at(int x,int z) const { return h[z*size + x]; }
+            std::vector<float> h;                   // owned samples, empty while viewing a mapped file
+            float* data;                            // the live samples, in h or in mapping
+            std::shared_ptr<MappedFile> mapping;    // may be shared with other chunks (world archive)
+
+            HeightMap(int s, float c) : size(s), cell(c), h(s*s, 0.0f), data(h.data()) {}
+            HeightMap(const HeightMap&) = delete;
+            HeightMap& operator=(const HeightMap&) = delete;
+
+            size_t count() const { return (size_t)size*size; }
+            float& at(int x,int z){ return data[z*size + x]; }
+            float  at(int x,int z) const { return data[z*size + x]; }
+            float* row(int z) { return &data[z*size]; }
+            const float* row(int z) const { return &data[z*size]; }
             bool inBounds(int x,int z) const { return x>=0 && z>=0 && x<size && z<size; }
-
+            bool isMapped() const { return mapping != nullptr; }
+
+            // Views count() floats at byteOffset inside a copy-on-write mapping; offset must keep
+            // them aligned. Edits fault in private copies of just the pages they touch.
+            void view(std::shared_ptr<MappedFile> file, size_t byteOffset) {
+                mapping = std::move(file);
+                data = (float*)(mapping->data() + byteOffset);
+                std::vector<float>().swap(h);
+            }
+            // Owned storage filled from src, which may be unaligned or inside the current mapping
+            void copyFrom(const void* src) {
+                h.resize(count());
+                std::memcpy(h.data(), src, count()*sizeof(float));
+                data = h.data();
+                mapping.reset();
+            }
+            // Drops the mapping, keeping the current samples
+            void own() { if(mapping) copyFrom(data); }
             
             // Bilinear sample height at world-space XZ
             float sampleHeight(float wx, float wz) const {
@@ -51,6 +78,7 @@ struct HeightMap {
 
 //We remove any padding here that the compiler might add, so we can successfully load it straight from memory into RAM and it "autoparses" it to the correct HMapHeader!
 #pragma pack(push,1)
+// HMP1: still read, never written. The 20-byte header leaves the floats unaligned.
 struct HMapHeader {
     char magic[4];
     uint32_t size;
@@ -58,63 +86,141 @@ struct HMapHeader {
     uint32_t gridX;
     uint32_t gridZ;
 };
+// HMP2: same fields, then the size*size float payload starts at payloadOffset, a multiple of
+// kHMapPageSize, so a mapped file can be used as the heightmap in place. The padding in between
+// starts with pyramidBytes of HeightPyramid::writeSummary (0 in older files).
+struct HMapHeader2 {
+    char magic[4];
+    uint32_t size;
+    float cell;
+    uint32_t gridX;
+    uint32_t gridZ;
+    uint32_t pyramidBytes;
+    uint64_t payloadOffset;
+    uint64_t payloadBytes;
+};
 #pragma pack(pop)
+constexpr uint64_t kHMapPageSize = 4096;
+
+// Inclusive cell rectangle of samples edited since the last GPU upload.
+struct DirtyRect {
+    int x0=0, z0=0, x1=-1, z1=-1;
+
+    bool empty() const { return x1 < x0 || z1 < z0; }
+    void clear() { x0=z0=0; x1=z1=-1; }
+    void expand(int ax0,int az0,int ax1,int az1){
+        if(empty()){ x0=ax0; z0=az0; x1=ax1; z1=az1; return; }
+        x0 = std::min(x0,ax0); z0 = std::min(z0,az0);
+        x1 = std::max(x1,ax1); z1 = std::max(z1,az1);
+    }
+};
 
 enum class BrushMode { RaiseLower, Smooth, Flat};
+enum class SmoothFilter { Box, Gaussian };
 struct Brush {
     float radius=6.0f;
     bool Falloff=true;
     float strength=1.0f;
     BrushMode mode=BrushMode::RaiseLower;
+    int smoothRadius=1;                         // filter half-width in cells, 1 = the classic 3x3
+    SmoothFilter smoothFilter=SmoothFilter::Box;
+    float spacing=0.25f;                        // distance between stroke dabs, as a fraction of radius
+};
+
+// Everything a brush kernel needs for one dab, resolved once before the row loop
+struct BrushDab {
+    int x0, z0, x1, z1;     // clamped footprint in cells
+    float hitX, hitZ;       // chunk-local hit
+    float radius;
+    float amount;           // RaiseLower: signed height delta at the centre
+    float blend;            // Smooth: mix factor towards the filtered height
+    float value;            // Flat: height written inside the radius
 };
 
 class TerrainChunk {
 
     public:
-        TerrainChunk(int gridSize=128, float cellSize=1.0f) : hm(gridSize, cellSize) {}
-        ~TerrainChunk(){ mesh.destroy(); }
+        TerrainChunk(int gridSize=128, float cellSize=1.0f) : hm(gridSize, cellSize) { pyramid.build(hm); markAllDirty(); }
         // CPU access
         float heightAt(int x,int z) const { return hm.at(x,z); }
         float getHeightAt(float x, float y) const;
         glm::vec3 normalAt(int x,int z) const { return hm.normalAt(x,z); }
         bool inBounds(int x,int z) const { return hm.inBounds(x,z); }
-        bool rayHeightmapIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDistance, float maxDist, glm::vec3& outHit);
+        // Chunk-local picking through the min/max pyramid
+        bool rayHeightmapIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDistance, float maxDist, glm::vec3& outHit, PickStats* stats=nullptr) const;
+        // Exact 2D DDA walk over every cell along the ray, without the pyramid; picking benchmark reference
+        bool rayGridIntersect(const glm::vec3& rayOrigin, const glm::vec3& rayDistance, float maxDist, glm::vec3& outHit, PickStats* stats=nullptr) const;
+        const HeightPyramid& heightPyramid() const { return pyramid; }
+        // World-space AABB. The Y range is the pyramid root, which every edit refreshes bottom-up
+        // over the touched nodes only, so this never rescans hm.
+        void bounds(glm::vec3& bmin, glm::vec3& bmax) const {
+            float span = (hm.size - 1) * hm.cell;
+            bmin = position + glm::vec3(0.0f, pyramid.minHeight(), 0.0f);
+            bmax = position + glm::vec3(span, pyramid.maxHeight(), span);
+        }
         bool contains(float wx, float wz);
+        // Writes HMP2 through a temp file and rename, then views the new file
         bool saveHMap(const std::string& path);
+        // HMP2 is mapped and viewed in place, HMP1 is copied out
         bool loadHMap(const std::string& path);
+        // Becomes chunk gridX/gridZ with its heights viewed at byteOffset in file (a world archive
+        // payload, see WorldArchive)
+        void viewHeights(std::shared_ptr<MappedFile> file, size_t byteOffset, int gx, int gz);
+        // Edited since the last markSaved(); a new chunk starts out unsaved
+        bool hasUnsavedEdits() const { return unsaved; }
+        void markSaved() { unsaved = false; }
         
 
-        // GPU mesh
-        void buildMesh();
+        // GPU data lives in one slot of the map's arena, which must outlive this chunk's use of it;
+        // queues the whole chunk for the next updateMeshIfDirty, in the arena's render mode
+        void buildMesh(TerrainArena& target, int targetSlot);
         void updateMeshIfDirty();
         void resetHeightMap();
-        void Render(bool wire=false);
+        int arenaSlot() const { return slot; }
+        const TerrainArena* meshArena() const { return arena; }
+        // Samples changed since the last call, for renderers that keep their own copy of hm
+        // (CdlodRenderer). Independent of the chunk's own mesh updates.
+        DirtyRect takeHeightEdits() { DirtyRect r = heightEdits; heightEdits.clear(); return r; }
+        // Geomipmap level and stitch mask (TerrainIndexBuffer::Edge bits) used by TerrainMap::render
+        void setLod(int level, int stitchMask) { lod = level; lodStitch = stitchMask; }
+        int lodLevel() const { return lod; }
+        int lodStitchMask() const { return lodStitch; }
         
         // Brush editing
         void applyBrush(const Brush& b, const glm::vec3& hit, bool lower=false);
+        // Several world-space dabs in one pass over their union footprint; weight scales each dab
+        void applyDabs(const Brush& b, const std::vector<glm::vec3>& worldHits, float weight, bool lower=false);
         
-        float circleOffset = 0.15f;
         HeightMap hm;
 
         glm::vec3 position;
-        int gridX;
-        int gridZ;
+        int gridX = -1;
+        int gridZ = -1;
 
 
     private:
-        void drawMesh();
+        void fillVertex(int x, int z, VertexPNUV& v) const;
+        void fillVertex(int x, int z, VertexCompact& v) const;
+        template<typename Vertex> void fillRect(const DirtyRect& r, std::vector<Vertex>& out) const;
+        template<typename Vertex> void uploadRect(const DirtyRect& r, std::vector<Vertex>& scratch);
+        // Marks a cell rectangle dirty, grown by one cell so neighbouring normals get rebuilt too
+        void markDirty(int x0, int z0, int x1, int z1);
+        void markAllDirty() { dirtyRect = heightEdits = {0, 0, hm.size-1, hm.size-1}; unsaved = true; }
+        bool makeDab(const Brush& b, const glm::vec3& hit, float weight, bool lower, BrushDab& d) const;
+        void runDabs(const Brush& b);
      
-        struct TerrainGL {
-            GLuint vao=0, vbo=0, ibo=0; GLsizei indexCount=0;
-            void destroy(){
-                if(ibo) glDeleteBuffers(1,&ibo);
-                if(vbo) glDeleteBuffers(1,&vbo);
-                if(vao) glDeleteVertexArrays(1,&vao);
-                vao=vbo=ibo=0; indexCount=0;
-            }
-        };
-
-        TerrainGL mesh;
-        bool dirty = true;
+        TerrainArena* arena = nullptr;       // owned by TerrainMap
+        int slot = -1;
+        int lod = 0;
+        int lodStitch = 0;
+        DirtyRect dirtyRect;
+        DirtyRect heightEdits;               // see takeHeightEdits
+        bool unsaved = true;                 // see hasUnsavedEdits
+        HeightPyramid pyramid;               // min/max quadtree kept in sync with hm by every edit
+        std::vector<VertexPNUV> uploadVerts; // scratch reused between partial uploads
+        std::vector<VertexCompact> uploadCompact;
+        std::vector<float> smoothScratch;    // filtered copy of the footprint used by the Smooth brush
+        std::vector<int> smoothSpans;        // covered x-span per footprint row, Smooth brush
+        std::vector<BrushDab> dabs;          // dabs of the pass being applied
 
     };
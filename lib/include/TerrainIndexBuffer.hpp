@@ -0,0 +1,44 @@
+#pragma once
+#include "glad/glad.h"
+#include <cstddef>
+#include <vector>
+
+// Triangle-list index buffer for a gridSize x gridSize vertex lattice. Every chunk of the map
+// has the same layout, so TerrainMap builds one of these and the TerrainArena VAO points at it.
+//
+// It holds every geomipmap level at once. Level l draws every 2^l-th sample (the last row and
+// column are always kept, so 255 cells still close the chunk). Each level is split into an
+// interior block and a one-quad border ring. The ring comes in 16 variants, one per combination
+// of coarser neighbours: on a stitched edge the odd vertices are snapped onto the neighbour's
+// lattice, so both sides share the same edge segments and no cracks open. Indices still address
+// the full-resolution vertex array, so the VBO/texture layouts don't change per level.
+class TerrainIndexBuffer {
+    public:
+        static constexpr int kMaxLods = 4;              // strides 1, 2, 4, 8
+        // Stitch mask bits: set when the neighbour on that side is one level coarser
+        enum Edge { EdgeNegX = 1, EdgePosX = 2, EdgeNegZ = 4, EdgePosZ = 8 };
+
+        ~TerrainIndexBuffer(){ destroy(); }
+
+        // (Re)builds the buffer if gridSize changed; a no-op otherwise
+        void build(int gridSize);
+        void destroy();
+
+        GLuint handle() const { return ibo; }
+        int lodCount() const { return lods; }
+        // Queues the two ranges (interior, ring) that draw level lod with the given stitch mask
+        void appendDraw(int lod, int stitchMask, std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const;
+        GLsizei triangleCount(int lod, int stitchMask) const;
+
+    private:
+        struct Range { size_t offset = 0; GLsizei count = 0; };   // offset in bytes
+        static const int kRangesPerLod = 17;                      // interior + 16 rings
+
+        GLuint ibo = 0;
+        int size = 0;
+        int lods = 0;
+        std::vector<Range> ranges;                                // lods * kRangesPerLod
+
+        const Range& interior(int lod) const { return ranges[lod*kRangesPerLod]; }
+        const Range& ring(int lod, int mask) const { return ranges[lod*kRangesPerLod + 1 + mask]; }
+};
@@ -14,33 +14,110 @@
 #include <cmath>
 #include <Shader.hpp>
 #include "TerrainChunk.hpp"
+#include "ThreadPool.hpp"
+#include "Frustum.hpp"
+#include "WorldArchive.hpp"
 
 #include <filesystem>
 #include <sstream>
 
+// One result of TerrainMap::raycastBatch
+struct RayHit {
+    bool hit = false;
+    glm::vec3 position{0.0f};
+    float distance = 0.0f;     // from the ray origin, in world units
+};
+
 class TerrainMap {
 public:
     TerrainMap(int worldSizeX, int worldSizeZ, int chunkSize, float cellSize);
 
     void build();
-    void render(bool wire=false);
+    // Draws every chunk with shader, which must already be bound and match getRenderMode(), as one
+    // multi-draw over the arena. With a frustum, chunks whose bounds lie outside it are skipped.
+    void render(Shader& shader, const Frustum* frustum=nullptr);
+    // Geomipmapping: gives every chunk the coarsest level whose error, seen from camPos, projects to
+    // at most maxPixelError pixels (fovY in radians), then limits neighbours to one level apart
+    void selectLods(const glm::vec3& camPos, float viewportHeight, float fovY, float maxPixelError);
+    void resetLods();                       // back to full resolution everywhere
+    long long lastTriangleCount() const { return drawnTriangles; }
+    int lastVisibleCount() const { return visibleChunks; }
+    int lastCulledCount() const { return culledChunks; }
+    // Switches how chunks reach the GPU (see TerrainRenderMode), rebuilding every mesh
+    void setRenderMode(TerrainRenderMode mode);
+    TerrainRenderMode getRenderMode() const { return renderMode; }
     void applyBrush(const Brush& b, const glm::vec3& hit, bool lower=false);
-    void updateDirtyChunks();
+    // All dabs of one frame, brushed in a single pass per overlapped chunk
+    void applyStroke(const Brush& b, const std::vector<glm::vec3>& dabs, float weight, bool lower=false);
+    // Uploads pending mesh edits of the chunks inside frustum (all with none); the others wait
+    // until render() finds them visible
+    void updateDirtyChunks(const Frustum* frustum=nullptr);
     float getHeightGlobal(float x, float z);
+    // World-space pick: walks the chunk grid front-to-back along the ray and stops at the first hit
+    bool raycast(const glm::vec3& ro, const glm::vec3& rd, float maxDist, glm::vec3& outHit, PickStats* stats=nullptr);
+    // Same query for many rays: outHits[i] answers origins[i]/dirs[i]. Rays are clipped in packets
+    // of four, grouped by the chunk they enter and traced on the worker pool.
+    void raycastBatch(const std::vector<glm::vec3>& origins, const std::vector<glm::vec3>& dirs,
+                      float maxDist, std::vector<RayHit>& outHits);
 
-    void save(const std::string& folderPath);
-    void load(const std::string& folderPath);
+    // World archive (see WorldArchive). While the archive at archivePath is open, save() only
+    // appends the chunks edited since the last save; it rewrites the whole file otherwise, or once
+    // dead space outgrows the live chunks. load() views the chunk payloads in place and checks a
+    // chunk's checksum only before it is first brushed or rewritten (all of them up front with
+    // verifyAll); a corrupt chunk is replaced by a flat one either way.
+    bool save(const std::string& archivePath);
+    bool load(const std::string& archivePath, bool verifyAll=false);
+    // Old layout, one chunk_X_Z.hmap per chunk in a folder
+    void exportFolder(const std::string& folderPath);
+    void importFolder(const std::string& folderPath);
 
     // std::vector<TerrainChunk>& GetChunks();
     std::vector<std::unique_ptr<TerrainChunk>>& GetChunks();
-    // TerrainChunk* getChunkAt(glm::vec3 worldPos);
     TerrainChunk* getChunkAt(const glm::vec3& worldPos);
+    TerrainChunk* getChunkAtGrid(int gx, int gz);
+    int gridWidth() const { return chunksX; }
+    int gridDepth() const { return chunksZ; }
+    int getChunkSize() const { return chunkSize; }
+    float getCellSize() const { return cellSize; }
 
 private:
+    void rebuildGridIndex();
+
     int chunksX, chunksZ;      // number of chunks in each direction
     int chunkSize;             // number of samples per chunk
     float cellSize;
     // std::vector<TerrainChunk> chunks;
     std::vector<std::unique_ptr<TerrainChunk>> chunks;
+    std::vector<TerrainChunk*> chunkGrid; // chunksX*chunksZ, row-major by gridZ; nullptr for holes
+    TerrainIndexBuffer indices;           // shared by every chunk, built once by build()
+    TerrainArena arena;                   // all chunk vertex data; slot = grid index
+    WorldArchive archive;                 // last saved/loaded archive, chunks may view its mapping
+    std::vector<uint8_t> unverified;      // per grid cell: loaded without checking its checksum yet
+    std::vector<GLsizei> drawCounts;      // render() multi-draw lists, reused between frames
+    std::vector<const void*> drawOffsets;
+    std::vector<GLint> drawBases;
+    TerrainRenderMode renderMode = TerrainRenderMode::FullVertex;
+    std::vector<int> chunkLod;              // per grid cell, scratch for selectLods
+    long long drawnTriangles = 0;           // by the last render()
+    int visibleChunks = 0, culledChunks = 0; // by the last render()
+
+    void collectBrushTargets(float minX, float minZ, float maxX, float maxZ);
+    // Checks a lazily loaded chunk against its archive checksum once; false if it was corrupt
+    // (it is flat now)
+    bool verifyChunk(TerrainChunk& chunk);
+    // skipEntry: the caller already tested the chunk the ray enters (raycastBatch packets)
+    bool walkChunks(const glm::vec3& ro, const glm::vec3& rd, const glm::vec3& invRd,
+                    float tEnter, float tExit, glm::vec3& outHit, PickStats* stats, bool skipEntry=false);
+
+    ThreadPool workers;
+    std::vector<TerrainChunk*> brushTargets; // chunks overlapped by the current dab/stroke
+
+    // raycastBatch scratch, reused between calls
+    static const int kPacketsPerTask = 64;
+    static const int kRaysPerTask = 128;
+    std::vector<float> batchEnter, batchExit;
+    std::vector<int> batchKey;   // entry chunk grid index per ray, -1 if the ray misses the map
+    std::vector<int> batchStart; // counting-sort offsets per chunk
+    std::vector<int> batchOrder; // ray indices sorted by entry chunk
 
 };
\ No newline at end of file
@@ -0,0 +1,127 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fork/join pool for per-chunk work. parallelFor hands out indices to the workers and
+// the calling thread and returns once every index has run. Meant to be driven from one thread
+// (the main loop); it is not reentrant.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned workerCount = defaultWorkerCount())
+    {
+        for (unsigned i = 0; i < workerCount; ++i)
+            m_Workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_Mutex);
+            m_Stop = true;
+        }
+        m_WakeCv.notify_all();
+        for (auto& t : m_Workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return (unsigned)m_Workers.size() + 1; }
+
+    // Runs fn(i) for every i in [0,count). Blocks until all calls have returned.
+    void parallelFor(int count, const std::function<void(int)>& fn)
+    {
+        if (count <= 0) return;
+        if (m_Workers.empty() || count == 1)
+        {
+            for (int i = 0; i < count; ++i) fn(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(m_Mutex);
+            m_Job = &fn;
+            m_JobCount = count;
+            m_Next.store(0);
+            m_Done = 0;
+            ++m_Generation;
+        }
+        m_WakeCv.notify_all();
+
+        runIndices(fn, count);
+
+        std::unique_lock<std::mutex> lk(m_Mutex);
+        // Also wait for workers still holding the job pointer, so fn can't dangle
+        m_DoneCv.wait(lk, [&] { return m_Done == count && m_Active == 0; });
+        m_Job = nullptr;
+    }
+
+    static unsigned defaultWorkerCount()
+    {
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw > 1 ? hw - 1 : 0;
+    }
+
+private:
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeCv;
+    std::condition_variable m_DoneCv;
+
+    const std::function<void(int)>* m_Job = nullptr;
+    int m_JobCount = 0;
+    int m_Done = 0;
+    int m_Active = 0;
+    std::atomic<int> m_Next{0};
+    uint64_t m_Generation = 0;
+    bool m_Stop = false;
+
+    void runIndices(const std::function<void(int)>& fn, int count)
+    {
+        int ran = 0;
+        for (int i = m_Next.fetch_add(1); i < count; i = m_Next.fetch_add(1))
+        {
+            fn(i);
+            ++ran;
+        }
+        if (ran == 0) return;
+
+        std::lock_guard<std::mutex> lk(m_Mutex);
+        m_Done += ran;
+        if (m_Done == count) m_DoneCv.notify_all();
+    }
+
+    void workerLoop()
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            const std::function<void(int)>* job;
+            int count;
+            {
+                std::unique_lock<std::mutex> lk(m_Mutex);
+                m_WakeCv.wait(lk, [&] { return m_Stop || m_Generation != seen; });
+                if (m_Stop) return;
+                seen = m_Generation;
+                job = m_Job;
+                count = m_JobCount;
+                if (!job) continue;
+                ++m_Active;
+            }
+            runIndices(*job, count);
+
+            std::lock_guard<std::mutex> lk(m_Mutex);
+            if (--m_Active == 0) m_DoneCv.notify_all();
+        }
+    }
+};
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.hpp"
+
+// Single-file world:
+//
+//   [ArchiveHeader, padded to one page][payload][payload]...[index: indexCount ArchiveEntry]
+//
+// Any chunk is found through the index without touching the others, and payloads start on page
+// boundaries so chunks can view them straight out of the mapping, like HMP2 files.
+// Saving a few chunks appends their new payloads and a new index at the end of the file, then
+// rewrites the header to point at them. The header write is the commit: until it lands the old
+// index and payloads are intact. Superseded bytes are counted as dead space until the next full
+// rewrite. Nothing below the old end of file changes except the header, so mappings taken before
+// an append stay valid.
+
+enum class ChunkCodec : uint32_t { RawF32 = 0 };   // size*size floats, row-major
+
+constexpr uint64_t kArchivePageSize = 4096;
+constexpr uint32_t kArchiveVersion = 1;
+constexpr uint32_t kArchiveMaxGrid = 1024;      // chunks per axis, bounds what a corrupt header can allocate
+
+#pragma pack(push,1)
+struct ArchiveHeader {
+    char magic[4];              // "TWA1"
+    uint32_t version;
+    uint32_t chunkSize;
+    float cellSize;
+    uint32_t chunksX;
+    uint32_t chunksZ;
+    uint64_t indexOffset;
+    uint32_t indexCount;
+    uint32_t indexChecksum;
+    uint64_t deadBytes;         // no longer referenced by the index
+};
+struct ArchiveEntry {
+    int32_t gridX;
+    int32_t gridZ;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t codec;             // ChunkCodec
+    uint32_t checksum;          // of the payload bytes
+};
+#pragma pack(pop)
+
+// One chunk handed to writeAll/append
+struct ArchiveChunk {
+    int gridX, gridZ;
+    const float* heights;
+    size_t count;
+};
+
+class WorldArchive {
+    public:
+        // Reads the header and index and maps the file; no payload is read
+        bool open(const std::string& path);
+        void close();
+        // Writes a complete archive through a temp file and rename, then opens it. On Windows every
+        // view of an archive at path must be dropped first.
+        bool writeAll(const std::string& path, int chunkSize, float cellSize, int chunksX, int chunksZ,
+                      const std::vector<ArchiveChunk>& chunks);
+        // Appends payloads for chunks plus a new index to the open archive, repoints the header
+        // and remaps. Views of the old mapping stay valid.
+        bool append(const std::vector<ArchiveChunk>& chunks);
+
+        bool isOpen() const { return file != nullptr; }
+        const std::string& path() const { return filePath; }
+        const ArchiveHeader& header() const { return hdr; }
+        const std::vector<ArchiveEntry>& entries() const { return index; }
+        const ArchiveEntry* find(int gridX, int gridZ) const;
+        // Shared by every chunk viewing a payload, so it lives as long as any of them
+        std::shared_ptr<MappedFile> mapping() const { return file; }
+        // Recomputes the payload checksum through the mapping
+        bool verify(const ArchiveEntry& e) const;
+
+        static uint32_t checksum(const void* data, size_t bytes);
+
+    private:
+        void rebuildLookup();
+        static uint64_t key(int gridX, int gridZ) { return ((uint64_t)(uint32_t)gridZ << 32) | (uint32_t)gridX; }
+
+        std::string filePath;
+        ArchiveHeader hdr = {};
+        std::vector<ArchiveEntry> index;
+        std::unordered_map<uint64_t, size_t> lookup;   // grid coords -> index entry
+        std::shared_ptr<MappedFile> file;
+};
@@ -0,0 +1,91 @@
+#version 330 core
+
+// CDLOD terrain: one shared uMeshDim x uMeshDim grid (no attributes, gl_VertexID gives the grid
+// position) placed and scaled per quadtree node. Odd grid vertices morph onto the parent lattice
+// as the camera distance approaches the end of the node's LOD ring.
+// Heights come from the chunk's full-resolution layer when it is resident (uChunkLayer), else from
+// the far copy holding every 2^uFarShift-th sample (see CdlodRenderer.hpp).
+uniform sampler2DArray uHeights;
+uniform isampler2D uChunkLayer;
+uniform sampler2D uFarHeights;
+uniform int uFarShift;
+uniform int uChunksX;
+uniform int uChunksZ;
+uniform int uChunkCells;     // cells per chunk side (chunk size - 1)
+uniform float uCellSize;
+uniform vec2 uWorldSize;     // map extent in world units
+uniform int uMeshDim;
+uniform vec2 uNodeOffset;
+uniform float uNodeScale;    // world units per mesh quad at this node's level
+uniform vec2 uMorph;         // distances where morphing starts / completes
+
+// FrameData block injected by ShaderVariants (FrameUniforms.hpp)
+
+out vec3 vN;
+out vec3 vW;
+out vec2 vUV;
+
+// Bilinear far copy at global sample position g. Texel i holds sample min(i << uFarShift, world),
+// so the last interval can be shorter than the others.
+float farHeightAt(vec2 g)
+{
+    vec2 world = vec2(ivec2(uChunksX, uChunksZ) * uChunkCells);
+    float step = float(1 << uFarShift);
+    ivec2 last = textureSize(uFarHeights, 0) - 1;
+    g = clamp(g, vec2(0.0), world);
+    ivec2 i = min(ivec2(floor(g / step)), max(last - 1, ivec2(0)));
+    vec2 x0 = vec2(i) * step;
+    vec2 f = clamp((g - x0) / max(min(x0 + step, world) - x0, vec2(1e-6)), 0.0, 1.0);
+    ivec2 j = min(i + 1, last);
+    float h00 = texelFetch(uFarHeights, i, 0).r,             h10 = texelFetch(uFarHeights, ivec2(j.x, i.y), 0).r;
+    float h01 = texelFetch(uFarHeights, ivec2(i.x, j.y), 0).r, h11 = texelFetch(uFarHeights, j, 0).r;
+    return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+}
+
+// Global sample s; neighbouring chunks share their border samples, the last one also owns the far edge
+float sampleAt(ivec2 s)
+{
+    s = clamp(s, ivec2(0), ivec2(uChunksX, uChunksZ) * uChunkCells);
+    ivec2 c = min(s / uChunkCells, ivec2(uChunksX - 1, uChunksZ - 1));
+    int layer = texelFetch(uChunkLayer, c, 0).r;
+    if(layer < 0) return farHeightAt(vec2(s));
+    return texelFetch(uHeights, ivec3(s - c * uChunkCells, layer), 0).r;
+}
+
+// Bilinear height at world XZ; vertices caught mid-morph sit between samples
+float heightAt(vec2 w)
+{
+    vec2 g = w / uCellSize;
+    ivec2 c = clamp(ivec2(floor(g)) / uChunkCells, ivec2(0), ivec2(uChunksX - 1, uChunksZ - 1));
+    if(texelFetch(uChunkLayer, c, 0).r < 0) return farHeightAt(g);
+    ivec2 i = ivec2(floor(g));
+    vec2 f = g - vec2(i);
+    float h00 = sampleAt(i),              h10 = sampleAt(i + ivec2(1,0));
+    float h01 = sampleAt(i + ivec2(0,1)), h11 = sampleAt(i + ivec2(1,1));
+    return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+}
+
+void main()
+{
+    vec2 grid = vec2(gl_VertexID % (uMeshDim + 1), gl_VertexID / (uMeshDim + 1));
+    vec2 w = uNodeOffset + grid * uNodeScale;
+
+    float d = distance(uCamPos.xyz, vec3(w.x, heightAt(min(w, uWorldSize)), w.y));
+    float k = clamp((d - uMorph.x) / (uMorph.y - uMorph.x), 0.0, 1.0);
+    w -= fract(grid * 0.5) * 2.0 * uNodeScale * k;
+    w = min(w, uWorldSize);  // nodes overhanging the map collapse onto its edge
+
+    float h = heightAt(w);
+    float e = uCellSize;
+    float hL = heightAt(w - vec2(e,0)), hR = heightAt(w + vec2(e,0));
+    float hD = heightAt(w - vec2(0,e)), hU = heightAt(w + vec2(0,e));
+    vec3 n = normalize(vec3(-(hR - hL) / (2.0 * e), 1.0, -(hU - hD) / (2.0 * e)));
+
+    vec3 pos = vec3(w.x, h, w.y);
+    vec4 wpos = uModel * vec4(pos,1.0);
+    vW = wpos.xyz;
+    vN = normalize(uNrmM * n);
+    vUV = w / (uChunkCells * uCellSize);   // chunk coordinate; hmap.fs (CDLOD) makes it chunk-local
+
+    gl_Position = uMVP * vec4(pos,1.0);
+}
@@ -1,24 +1,97 @@
 #version 330 core
+// Permutations (see ShaderVariants):
+//   FLAT_SHADING  per-face normal from screen-space derivatives of the world position
+//   WIREFRAME     inputs come through hmap.g, which adds barycentrics for the edge overlay
+//   CDLOD         set for the whole cdlod.vs family, see below
+#ifdef WIREFRAME
 in vec3 gsN;
+in vec3 gsW;
 in vec2 gsUV;
-flat in vec3 triColor;
+in vec3 gsBary;
+#define fN gsN
+#define fW gsW
+#define fUV gsUV
+#else
+in vec3 vN;
+in vec3 vW;
+in vec2 vUV;
+#define fN vN
+#define fW vW
+#define fUV vUV
+#endif
 
 out vec4 frag;
 
-uniform vec3 uLightDir = normalize(vec3(0.3,1.0,0.2));
-uniform bool uFlatShading = false;
+#ifdef CDLOD
+// cdlod.vs passes the continuous chunk coordinate (world XZ over one chunk's extent) instead of a
+// chunk-local UV. A CDLOD triangle can span a chunk border, where the local UV jumps from 1 back
+// to 0, so it is resolved per pixel here; the last chunk owns 1.0 like in hmap.vs.
+uniform int uChunksX;
+uniform int uChunksZ;
+#endif
+
+// FrameData block injected by ShaderVariants (FrameUniforms.hpp)
+#ifdef WIREFRAME
+uniform float uWireWidth = 1.0;                  // edge width in pixels
+uniform vec3 uWireColor = vec3(0.05,0.08,0.05);
+#endif
 
 void main()
 {
-    if(uFlatShading)
-    {
-        frag = vec4(triColor,1.0);
-    }
-    else
+#ifdef FLAT_SHADING
+    // Constant across the triangle; terrain always faces up, so orient it towards +Y
+    vec3 n = normalize(cross(dFdx(fW), dFdy(fW)));
+    if(n.y < 0.0) n = -n;
+#else
+    vec3 n = normalize(fN);
+#endif
+    float ndl = max(dot(n, uLightDir.xyz), 0.0);
+    vec2 uv = fUV;
+#ifdef CDLOD
+    uv -= min(floor(uv), vec2(uChunksX - 1, uChunksZ - 1));
+#endif
+    vec3 base = mix(vec3(0.15,0.35,0.15), vec3(0.5,0.4,0.3), uv.y);
+    vec3 col = base * (0.2 + 0.8*ndl);
+
+    // Brush cursor decal: the inside is tinted with a one-pixel anti-aliased outline at the radius.
+    // Only RaiseLower has a falloff curve, so only it is tinted by one; Smooth and Flat act
+    // uniformly inside the radius. Drawn on the shaded surface itself, so it follows the terrain
+    // exactly.
+    if(uBrush.w > 0.0)
     {
-        float ndl = max(dot(normalize(gsN), normalize(uLightDir)), 0.0);
-        vec3 base = mix(vec3(0.15,0.35,0.15), vec3(0.5,0.4,0.3), gsUV.y);
-        vec3 col = base * (0.2 + 0.8*ndl);
-        frag = vec4(col,1.0);
+        float r = uBrush.w;
+        float d = distance(fW.xz, uBrush.xz);
+        float px = max(fwidth(d), 1e-4);
+        if(d < r + 2.0 * px)
+        {
+            int mode = int(uBrushParams.y + 0.5);
+            bool falloff = uBrushParams.x > 0.5;
+            bool lower = uBrushParams.z > 0.5;
+            vec3 tint;
+            float w = 1.0;
+            if(mode == 1) tint = vec3(0.3,0.6,1.0);
+            else if(mode == 2) {
+                // The falloff flag picks Flat's variant: flatten, or step up/down (lowering wins)
+                tint = lower ? vec3(0.55,0.2,0.75) : falloff ? vec3(1.0,0.4,0.9) : vec3(1.0,0.7,0.95);
+            }
+            else {
+                tint = lower ? vec3(1.0,0.35,0.2) : vec3(1.0,0.85,0.2);
+                if(falloff) w = 0.5 * (cos(3.14159265 * clamp(d / r, 0.0, 1.0)) + 1.0);
+            }
+            float inside = 1.0 - smoothstep(r - px, r, d);
+            col = mix(col, tint, 0.35 * w * inside);
+            float outline = 1.0 - smoothstep(0.5 * px, 1.5 * px, abs(d - r));
+            col = mix(col, vec3(0.0), outline);
+        }
     }
-}
\ No newline at end of file
+
+#ifdef WIREFRAME
+    // Distance to the nearest edge in pixels via the screen-space derivative of the
+    // barycentrics; smoothstep over one pixel anti-aliases the line
+    vec3 d = fwidth(gsBary);
+    vec3 a = smoothstep(d * (uWireWidth - 0.5), d * (uWireWidth + 0.5), gsBary);
+    float edge = 1.0 - min(min(a.x, a.y), a.z);
+    col = mix(col, uWireColor, edge);
+#endif
+    frag = vec4(col,1.0);
+}
@@ -1,23 +1,87 @@
 #version 330 core
 
+// Terrain vertex shader. Permutations (see ShaderVariants):
+//   default         full vertices: world position, normal and UV stored per vertex
+//   COMPACT_VERTEX  only the height and an octahedron-packed normal are stored
+//   HEIGHT_TEXTURE  no attributes; heights come from the chunk's layer of an R32F texture array
+// In the last two X/Z/UV come from gl_VertexID, which includes the chunk's arena base vertex: its
+// quotient by the slot size is the chunk's grid index, the remainder the sample inside it.
+
+#if defined(COMPACT_VERTEX)
+layout(location=0) in float aHeight;
+layout(location=1) in vec2 aOctNrm;
+#elif !defined(HEIGHT_TEXTURE)
 layout(location=0) in vec3 aPos;
 layout(location=1) in vec3 aNrm;
 layout(location=2) in vec2 aUV;
+#endif
+
+// FrameData block injected by ShaderVariants (FrameUniforms.hpp)
 
-uniform mat4 uMVP;
-uniform mat4 uModel;
-uniform mat3 uNrmM;
+#if defined(COMPACT_VERTEX) || defined(HEIGHT_TEXTURE)
+uniform int uChunksX;        // chunks per map row; arena slot = gz*uChunksX + gx
+uniform float uCellSize;
+uniform int uGridSize;
+#endif
+#ifdef HEIGHT_TEXTURE
+uniform sampler2DArray uHeightTex;
+#endif
 
 out vec3 vN;
 out vec3 vW;
 out vec2 vUV;
 
+#ifdef COMPACT_VERTEX
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if(n.y < 0.0)
+        n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+#endif
+
+#ifdef HEIGHT_TEXTURE
+int layer;
+
+// Edge texels reuse the centre for their missing neighbour, like normalAt
+float heightAt(ivec2 c)
+{
+    return texelFetch(uHeightTex, ivec3(clamp(c, ivec2(0), ivec2(uGridSize - 1)), layer), 0).r;
+}
+#endif
+
 void main()
 {
-    vec4 wpos = uModel * vec4(aPos,1.0);
+#if defined(COMPACT_VERTEX) || defined(HEIGHT_TEXTURE)
+    int slotVerts = uGridSize * uGridSize;
+    int slot = gl_VertexID / slotVerts;
+    int local = gl_VertexID - slot * slotVerts;
+    ivec2 c = ivec2(local % uGridSize, local / uGridSize);
+    vec2 origin = vec2(slot % uChunksX, slot / uChunksX) * float(uGridSize - 1) * uCellSize;
+
+  #ifdef COMPACT_VERTEX
+    float h = aHeight;
+    vec3 nrm = octDecode(aOctNrm);
+  #else
+    layer = slot;
+    float h = heightAt(c);
+    float hL = heightAt(c - ivec2(1,0)), hR = heightAt(c + ivec2(1,0));
+    float hD = heightAt(c - ivec2(0,1)), hU = heightAt(c + ivec2(0,1));
+    vec3 nrm = normalize(vec3(-(hR - hL) / (2.0 * uCellSize), 1.0, -(hU - hD) / (2.0 * uCellSize)));
+  #endif
+    vec3 pos = vec3(origin.x + c.x * uCellSize, h, origin.y + c.y * uCellSize);
+    vec2 uv = vec2(c) / float(uGridSize - 1);
+#else
+    vec3 pos = aPos;
+    vec3 nrm = aNrm;
+    vec2 uv = aUV;
+#endif
+
+    vec4 wpos = uModel * vec4(pos,1.0);
     vW = wpos.xyz;
-    vN = normalize(uNrmM * aNrm);
-    vUV = aUV;
+    vN = normalize(uNrmM * nrm);
+    vUV = uv;
 
-    gl_Position = uMVP * vec4(aPos,1.0);
-}
\ No newline at end of file
+    gl_Position = uMVP * vec4(pos,1.0);
+}
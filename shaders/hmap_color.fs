@@ -1,8 +0,0 @@
-#version 330 core
-out vec4 frag;
-uniform vec4 uColor; 
-
-void main()
-{
-    frag = uColor; 
-}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "Benchmark.h"
+#include <chrono>
+#include <iostream>
+
+// Screen-space grid of world rays through the view described by invVP
+static void makeScreenRays(const glm::mat4& invVP, int raysPerSide,
+                           std::vector<glm::vec3>& origins, std::vector<glm::vec3>& dirs)
+{
+    origins.clear(); dirs.clear();
+    for (int j = 0; j < raysPerSide; ++j) {
+        for (int i = 0; i < raysPerSide; ++i) {
+            float xN = (i + 0.5f) / raysPerSide * 2.0f - 1.0f;
+            float yN = (j + 0.5f) / raysPerSide * 2.0f - 1.0f;
+            glm::vec4 p0 = invVP * glm::vec4(xN, yN, -1, 1); p0 /= p0.w;
+            glm::vec4 p1 = invVP * glm::vec4(xN, yN,  1, 1); p1 /= p1.w;
+            origins.push_back(glm::vec3(p0));
+            dirs.push_back(glm::normalize(glm::vec3(p1 - p0)));
+        }
+    }
+}
+
+template<typename PickFn>
+static int pickAll(TerrainMap& map, const std::vector<glm::vec3>& origins, const std::vector<glm::vec3>& dirs,
+                   PickStats& stats, PickFn pick)
+{
+    int hits = 0;
+    for (size_t r = 0; r < origins.size(); ++r) {
+        float closestT = 1e9f;
+        bool hasHit = false;
+        for (auto& chunk : map.GetChunks()) {
+            glm::vec3 localRo = origins[r] - chunk->position;
+            glm::vec3 tmpHitLocal;
+            if (pick(*chunk, localRo, dirs[r], tmpHitLocal, stats)) {
+                float t = glm::length(tmpHitLocal + chunk->position - origins[r]);
+                if (t < closestT) { closestT = t; hasHit = true; }
+            }
+        }
+        hits += hasHit;
+    }
+    return hits;
+}
+
+void runPickingBenchmark(TerrainMap& map, const glm::mat4& invVP, int raysPerSide)
+{
+    std::vector<glm::vec3> origins, dirs;
+    makeScreenRays(invVP, raysPerSide, origins, dirs);
+
+    auto report = [&](const char* name, int hits, const PickStats& s, double ms) {
+        double n = (double)origins.size();
+        // A run below the clock's resolution has no meaningful rate (and inf doesn't convert to long long)
+        long long rate = ms > 0.0 ? (long long)(n / (ms * 1e-3)) : 0;
+        std::cout << "[Benchmark] " << name << ": " << ms << " ms (" << rate << " rays/s), "
+                  << hits << "/" << origins.size() << " hits, " << s.chunksVisited / n << " chunks/ray, " << s.nodesVisited / n << " nodes/ray, "
+                  << s.cellsTested / n << " cells/ray" << std::endl;
+    };
+
+    PickStats gridStats;
+    auto start = std::chrono::high_resolution_clock::now();
+    int gridHits = pickAll(map, origins, dirs, gridStats,
+        [](const TerrainChunk& c, const glm::vec3& ro, const glm::vec3& rd, glm::vec3& hit, PickStats& s) {
+            return c.rayGridIntersect(ro, rd, 4000.0f, hit, &s);
+        });
+    auto mid = std::chrono::high_resolution_clock::now();
+
+    PickStats pyramidStats;
+    int pyramidHits = pickAll(map, origins, dirs, pyramidStats,
+        [](const TerrainChunk& c, const glm::vec3& ro, const glm::vec3& rd, glm::vec3& hit, PickStats& s) {
+            return c.rayHeightmapIntersect(ro, rd, 4000.0f, hit, &s);
+        });
+    auto end = std::chrono::high_resolution_clock::now();
+
+    PickStats mapStats;
+    int mapHits = 0;
+    for (size_t r = 0; r < origins.size(); ++r) {
+        glm::vec3 hit;
+        mapHits += map.raycast(origins[r], dirs[r], 4000.0f, hit, &mapStats);
+    }
+    auto mapEnd = std::chrono::high_resolution_clock::now();
+
+    // The batch API doesn't take stats (it runs on several threads), so only time and hits are meaningful
+    std::vector<RayHit> batchHits;
+    map.raycastBatch(origins, dirs, 4000.0f, batchHits);
+    auto batchEnd = std::chrono::high_resolution_clock::now();
+    int batchHitCount = 0;
+    for (const RayHit& h : batchHits) batchHitCount += h.hit;
+
+    std::cout << "[Benchmark] Picking " << origins.size() << " rays over " << map.GetChunks().size() << " chunks" << std::endl;
+    report("grid DDA", gridHits, gridStats, std::chrono::duration<double, std::milli>(mid - start).count());
+    report("pyramid ", pyramidHits, pyramidStats, std::chrono::duration<double, std::milli>(end - mid).count());
+    report("map ray ", mapHits, mapStats, std::chrono::duration<double, std::milli>(mapEnd - end).count());
+    report("batch   ", batchHitCount, PickStats(), std::chrono::duration<double, std::milli>(batchEnd - mapEnd).count());
+}
@@ -0,0 +1,178 @@
+#include "BrushKernels.hpp"
+#include <cmath>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define BRUSH_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define BRUSH_SSE2 1
+#endif
+
+// sin(t) for t in [-pi/2, pi/2], Taylor terms up to t^9 (same coefficients as brushFalloffPoly)
+static const float kPi = 3.14159265f;
+static const float kS3 = -1.0f/6.0f;
+static const float kS5 = 1.0f/120.0f;
+static const float kS7 = -1.0f/5040.0f;
+static const float kS9 = 1.0f/362880.0f;
+
+#ifdef BRUSH_AVX2
+static inline __m256 brushFalloff8(__m256 u)
+{
+    __m256 t = _mm256_mul_ps(_mm256_set1_ps(kPi), _mm256_sub_ps(u, _mm256_set1_ps(0.5f)));
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_add_ps(_mm256_set1_ps(kS7), _mm256_mul_ps(t2, _mm256_set1_ps(kS9)));
+    p = _mm256_add_ps(_mm256_set1_ps(kS5), _mm256_mul_ps(t2, p));
+    p = _mm256_add_ps(_mm256_set1_ps(kS3), _mm256_mul_ps(t2, p));
+    p = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(t2, p));
+    __m256 s = _mm256_mul_ps(t, p);
+    return _mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(_mm256_set1_ps(0.5f), s));
+}
+#endif
+
+#ifdef BRUSH_SSE2
+static inline __m128 brushFalloff4(__m128 u)
+{
+    __m128 t = _mm_mul_ps(_mm_set1_ps(kPi), _mm_sub_ps(u, _mm_set1_ps(0.5f)));
+    __m128 t2 = _mm_mul_ps(t, t);
+    __m128 p = _mm_add_ps(_mm_set1_ps(kS7), _mm_mul_ps(t2, _mm_set1_ps(kS9)));
+    p = _mm_add_ps(_mm_set1_ps(kS5), _mm_mul_ps(t2, p));
+    p = _mm_add_ps(_mm_set1_ps(kS3), _mm_mul_ps(t2, p));
+    p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(t2, p));
+    __m128 s = _mm_mul_ps(t, p);
+    return _mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_set1_ps(0.5f), s));
+}
+#endif
+
+template<bool Falloff>
+void raiseLowerRow(float* row, int x0, int x1, float cell, float hitX, float dz2,
+                   float radius, float amount)
+{
+    int x = x0;
+
+#ifdef BRUSH_AVX2
+    {
+        const __m256 vCell = _mm256_set1_ps(cell);
+        const __m256 vHitX = _mm256_set1_ps(hitX);
+        const __m256 vDz2  = _mm256_set1_ps(dz2);
+        const __m256 vR    = _mm256_set1_ps(radius);
+        const __m256 vAmt  = _mm256_set1_ps(amount);
+        const __m256 lane  = _mm256_setr_ps(0,1,2,3,4,5,6,7);
+        for(; x + 7 <= x1; x += 8){
+            __m256 xs = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+            __m256 dx = _mm256_sub_ps(_mm256_mul_ps(xs, vCell), vHitX);
+            __m256 d  = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), vDz2));
+            __m256 inside = _mm256_cmp_ps(d, vR, _CMP_LE_OQ);
+            __m256 add = vAmt;
+            if constexpr (Falloff) add = _mm256_mul_ps(add, brushFalloff8(_mm256_div_ps(d, vR)));
+            add = _mm256_and_ps(inside, add);
+            _mm256_storeu_ps(row + x, _mm256_add_ps(_mm256_loadu_ps(row + x), add));
+        }
+    }
+#endif
+
+#ifdef BRUSH_SSE2
+    {
+        const __m128 vCell = _mm_set1_ps(cell);
+        const __m128 vHitX = _mm_set1_ps(hitX);
+        const __m128 vDz2  = _mm_set1_ps(dz2);
+        const __m128 vR    = _mm_set1_ps(radius);
+        const __m128 vAmt  = _mm_set1_ps(amount);
+        const __m128 lane  = _mm_setr_ps(0,1,2,3);
+        for(; x + 3 <= x1; x += 4){
+            __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), lane);
+            __m128 dx = _mm_sub_ps(_mm_mul_ps(xs, vCell), vHitX);
+            __m128 d  = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), vDz2));
+            __m128 inside = _mm_cmple_ps(d, vR);
+            __m128 add = vAmt;
+            if constexpr (Falloff) add = _mm_mul_ps(add, brushFalloff4(_mm_div_ps(d, vR)));
+            add = _mm_and_ps(inside, add);
+            _mm_storeu_ps(row + x, _mm_add_ps(_mm_loadu_ps(row + x), add));
+        }
+    }
+#endif
+
+    // Scalar tail (and the whole row on targets without SIMD)
+    for(; x <= x1; ++x){
+        float dx = x*cell - hitX;
+        float d = sqrtf(dx*dx + dz2);
+        if(d > radius) continue;
+        if constexpr (Falloff) row[x] += amount * brushFalloff(d / radius);
+        else                   row[x] += amount;
+    }
+}
+
+template void raiseLowerRow<true>(float*, int, int, float, float, float, float, float);
+template void raiseLowerRow<false>(float*, int, int, float, float, float, float, float);
+
+void flattenRow(float* row, int x0, int x1, float cell, float hitX, float dz2,
+                float radius, float value)
+{
+    int x = x0;
+
+#ifdef BRUSH_AVX2
+    {
+        const __m256 vCell = _mm256_set1_ps(cell);
+        const __m256 vHitX = _mm256_set1_ps(hitX);
+        const __m256 vDz2  = _mm256_set1_ps(dz2);
+        const __m256 vR    = _mm256_set1_ps(radius);
+        const __m256 vVal  = _mm256_set1_ps(value);
+        const __m256 lane  = _mm256_setr_ps(0,1,2,3,4,5,6,7);
+        for(; x + 7 <= x1; x += 8){
+            __m256 xs = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+            __m256 dx = _mm256_sub_ps(_mm256_mul_ps(xs, vCell), vHitX);
+            __m256 d  = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), vDz2));
+            __m256 inside = _mm256_cmp_ps(d, vR, _CMP_LE_OQ);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(_mm256_loadu_ps(row + x), vVal, inside));
+        }
+    }
+#endif
+
+#ifdef BRUSH_SSE2
+    {
+        const __m128 vCell = _mm_set1_ps(cell);
+        const __m128 vHitX = _mm_set1_ps(hitX);
+        const __m128 vDz2  = _mm_set1_ps(dz2);
+        const __m128 vR    = _mm_set1_ps(radius);
+        const __m128 vVal  = _mm_set1_ps(value);
+        const __m128 lane  = _mm_setr_ps(0,1,2,3);
+        for(; x + 3 <= x1; x += 4){
+            __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), lane);
+            __m128 dx = _mm_sub_ps(_mm_mul_ps(xs, vCell), vHitX);
+            __m128 d  = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), vDz2));
+            __m128 inside = _mm_cmple_ps(d, vR);
+            __m128 h = _mm_loadu_ps(row + x);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, vVal), _mm_andnot_ps(inside, h)));
+        }
+    }
+#endif
+
+    for(; x <= x1; ++x){
+        float dx = x*cell - hitX;
+        if(sqrtf(dx*dx + dz2) <= radius) row[x] = value;
+    }
+}
+
+void axpyRow(float* dst, const float* src, float w, int n)
+{
+    int i = 0;
+
+#ifdef BRUSH_AVX2
+    {
+        const __m256 vW = _mm256_set1_ps(w);
+        for(; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(vW, _mm256_loadu_ps(src + i))));
+    }
+#endif
+
+#ifdef BRUSH_SSE2
+    {
+        const __m128 vW = _mm_set1_ps(w);
+        for(; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(vW, _mm_loadu_ps(src + i))));
+    }
+#endif
+
+    for(; i < n; ++i) dst[i] += w * src[i];
+}
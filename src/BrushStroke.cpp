@@ -0,0 +1,32 @@
+#include "BrushStroke.hpp"
+#include <algorithm>
+
+float BrushStroke::update(const glm::vec3& hit, float dt, const Brush& b, std::vector<glm::vec3>& outDabs)
+{
+    outDabs.clear();
+
+    if(!active) {
+        // First frame of the stroke: one dab right under the cursor
+        active = true;
+        lastDab = hit;
+        outDabs.push_back(hit);
+    } else {
+        glm::vec2 delta(hit.x - lastDab.x, hit.z - lastDab.z);
+        float len = glm::length(delta);
+        float step = std::max(b.spacing * b.radius, 1e-3f);
+
+        if(len >= step) {
+            int n = (int)(len / step);
+            if(n > kMaxDabs) { step = len / kMaxDabs; n = kMaxDabs; }
+            glm::vec3 dir = (hit - lastDab) / len;
+            for(int i = 1; i <= n; ++i) outDabs.push_back(lastDab + dir * (step * i));
+            lastDab = outDabs.back();
+        }
+
+        // Holding still (or creeping slower than the spacing) keeps depositing under the cursor
+        if(outDabs.empty()) outDabs.push_back(hit);
+    }
+
+    float frameWeight = std::min(dt, kMaxFrameTime) * kReferenceRate;
+    return frameWeight / (float)outDabs.size();
+}
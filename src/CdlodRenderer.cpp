@@ -0,0 +1,396 @@
+#include "CdlodRenderer.hpp"
+#include "TerrainMap.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+// Fraction of a level's ring after which its vertices start morphing towards the parent
+static const float kMorphStart = 0.7f;
+// Largest side of the far height copy (also capped by GL_MAX_TEXTURE_SIZE)
+static const int kFarMaxSize = 4096;
+// Full-resolution chunk layers kept resident at most (also capped by GL_MAX_ARRAY_TEXTURE_LAYERS)
+static const int kMaxResidentLayers = 128;
+
+CdlodRenderer::CdlodRenderer(int gridDim) : gridDim(gridDim & ~1) {}
+
+CdlodRenderer::~CdlodRenderer()
+{
+    if(heightArray) glDeleteTextures(1, &heightArray);
+    if(layerTable) glDeleteTextures(1, &layerTable);
+    if(farHeights) glDeleteTextures(1, &farHeights);
+    if(ibo) glDeleteBuffers(1, &ibo);
+    if(vao) glDeleteVertexArrays(1, &vao);
+}
+
+// (gridDim+1)^2 vertices addressed by gl_VertexID, indices grouped by quadrant so a node can draw
+// any subset of its four children's areas
+void CdlodRenderer::buildMesh()
+{
+    const int half = gridDim / 2, verts = gridDim + 1;
+    std::vector<uint32_t> idx((size_t)gridDim * gridDim * 6);
+    uint32_t* out = idx.data();
+    for(int q = 0; q < 4; ++q){
+        int qx = (q & 1) * half, qz = (q >> 1) * half;
+        for(int z = qz; z < qz + half; ++z){
+            for(int x = qx; x < qx + half; ++x){
+                uint32_t i0 = z*verts + x, i1 = i0 + 1, i2 = i0 + verts, i3 = i2 + 1;
+                out[0] = i0; out[1] = i2; out[2] = i1;
+                out[3] = i1; out[4] = i2; out[5] = i3;
+                out += 6;
+            }
+        }
+    }
+    quadCount = (GLsizei)(idx.size() / 4);
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &ibo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size()*sizeof(uint32_t), idx.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+bool CdlodRenderer::allocate(int chunksX, int chunksZ, int size)
+{
+    const int cells = size - 1;
+    const int worldX = chunksX * cells, worldZ = chunksZ * cells;
+    GLint maxTex = 0, maxLayers = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTex);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    const int farLimit = std::min(kFarMaxSize, (int)maxTex);
+
+    // Coarsest lattice the far copy can afford; 0 keeps the map at full resolution
+    farShift = 0;
+    while(((std::max(worldX, worldZ) + (1 << farShift) - 1) >> farShift) + 1 > farLimit) ++farShift;
+    farW = ((worldX + (1 << farShift) - 1) >> farShift) + 1;
+    farH = ((worldZ + (1 << farShift) - 1) >> farShift) + 1;
+    // With a full-resolution far copy there is nothing to page; keep one layer so the array is complete
+    layerCapacity = farShift == 0 ? 1 : std::min({kMaxResidentLayers, (int)maxLayers, chunksX * chunksZ});
+
+    if(!farHeights) glGenTextures(1, &farHeights);
+    if(!heightArray) glGenTextures(1, &heightArray);
+    if(!layerTable) glGenTextures(1, &layerTable);
+
+    // Holes read as flat ground, so start from zeros
+    std::vector<float> zeros((size_t)farW * farH, 0.0f);
+    glBindTexture(GL_TEXTURE_2D, farHeights);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, farW, farH, 0, GL_RED, GL_FLOAT, zeros.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, size, size, layerCapacity, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Nothing is resident yet
+    std::vector<GLint> table((size_t)chunksX * chunksZ, -1);
+    glBindTexture(GL_TEXTURE_2D, layerTable);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, chunksX, chunksZ, 0, GL_RED_INTEGER, GL_INT, table.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    if(glGetError() != GL_NO_ERROR){
+        std::cerr << "[CDLOD] Failed to allocate height storage for " << chunksX << "x" << chunksZ << " chunks" << std::endl;
+        return false;
+    }
+
+    chunkLayer.assign((size_t)chunksX * chunksZ, -1);
+    chunkStamp.assign((size_t)chunksX * chunksZ, 0);
+    layerChunk.assign(layerCapacity, -1);
+    layerUsed.assign(layerCapacity, 0);
+    frameStamp = 0;
+    reportedShortage = false;
+    layersX = chunksX; layersZ = chunksZ; layerSize = size;
+    return true;
+}
+
+// Far texels whose sample lies inside r. Far column i holds global sample min(i << farShift, worldX),
+// so the last column always carries the map's far edge.
+void CdlodRenderer::uploadFar(const TerrainChunk& chunk, const DirtyRect& r)
+{
+    const int cells = layerSize - 1;
+    const int worldX = layersX * cells, worldZ = layersZ * cells, step = 1 << farShift;
+    const int ox = chunk.gridX * cells, oz = chunk.gridZ * cells;
+    const int sx0 = ox + r.x0, sx1 = ox + r.x1, sz0 = oz + r.z0, sz1 = oz + r.z1;
+    int i0 = (sx0 + step - 1) >> farShift, i1 = sx1 == worldX ? farW - 1 : sx1 >> farShift;
+    int j0 = (sz0 + step - 1) >> farShift, j1 = sz1 == worldZ ? farH - 1 : sz1 >> farShift;
+    if(i1 < i0 || j1 < j0) return;
+
+    const int w = i1 - i0 + 1, h = j1 - j0 + 1;
+    uploadScratch.resize((size_t)w * h);
+    for(int j = j0; j <= j1; ++j){
+        const float* row = chunk.hm.row(std::min(j << farShift, worldZ) - oz);
+        float* out = &uploadScratch[(size_t)(j - j0) * w];
+        for(int i = i0; i <= i1; ++i) out[i - i0] = row[std::min(i << farShift, worldX) - ox];
+    }
+    glBindTexture(GL_TEXTURE_2D, farHeights);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, i0, j0, w, h, GL_RED, GL_FLOAT, uploadScratch.data());
+}
+
+void CdlodRenderer::uploadLayer(const TerrainChunk& chunk, int layer, const DirtyRect& r)
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightArray);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, layerSize);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, r.x0, r.z0, layer, r.x1 - r.x0 + 1, r.z1 - r.z0 + 1, 1,
+                    GL_RED, GL_FLOAT, chunk.hm.row(r.z0) + r.x0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void CdlodRenderer::sync(TerrainMap& map)
+{
+    const int cx = map.gridWidth(), cz = map.gridDepth(), size = map.getChunkSize();
+    if(cx <= 0 || cz <= 0 || size < 2) return;
+    const bool layoutChanged = cx != layersX || cz != layersZ || size != layerSize;
+    // Already failed for this layout and said so; retry only once the map changes
+    if(storageFailed && !layoutChanged) return;
+    const bool realloc = !farHeights || layoutChanged;
+
+    if(realloc && !allocate(cx, cz, size)){
+        layersX = cx; layersZ = cz; layerSize = size;
+        if(farHeights) { glDeleteTextures(1, &farHeights); farHeights = 0; }
+        storageFailed = true;
+        return;
+    }
+    storageFailed = false;
+    if(!vao) buildMesh();
+
+    for(int gz = 0; gz < cz; ++gz){
+        for(int gx = 0; gx < cx; ++gx){
+            TerrainChunk* chunk = map.getChunkAtGrid(gx, gz);
+            if(!chunk) continue;
+            DirtyRect r = chunk->takeHeightEdits();
+            if(realloc) r = {0, 0, size-1, size-1};
+            if(r.empty()) continue;
+            uploadFar(*chunk, r);
+            int layer = chunkLayer[gz*cx + gx];
+            if(layer >= 0) uploadLayer(*chunk, layer, r);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Pages in full-resolution layers for every chunk under a selected node finer than farShift,
+// evicting the layers no selected node used for the longest
+void CdlodRenderer::updateResidency(TerrainMap& map)
+{
+    if(!farHeights || farShift == 0 || layersX != map.gridWidth() || layersZ != map.gridDepth()) return;
+    ++frameStamp;
+
+    needed.clear();
+    for(const Node& n : selected){
+        if(n.level >= farShift) continue;
+        // Node extent plus the one-sample apron the bilinear and normal taps reach into
+        const int sizeCells = gridDim << n.level;
+        const int x0 = std::max(n.x*sizeCells - 1, 0), z0 = std::max(n.z*sizeCells - 1, 0);
+        const int x1 = std::min((n.x+1)*sizeCells + 1, worldCellsX), z1 = std::min((n.z+1)*sizeCells + 1, worldCellsZ);
+        for(int gz = z0 / chunkCells; gz <= std::min(z1 / chunkCells, layersZ - 1); ++gz){
+            for(int gx = x0 / chunkCells; gx <= std::min(x1 / chunkCells, layersX - 1); ++gx){
+                const int idx = gz*layersX + gx;
+                if(chunkStamp[idx] == frameStamp || !map.getChunkAtGrid(gx, gz)) continue;
+                chunkStamp[idx] = frameStamp;
+                needed.push_back(idx);
+            }
+        }
+    }
+
+    for(int idx : needed) if(chunkLayer[idx] >= 0) layerUsed[chunkLayer[idx]] = frameStamp;
+
+    bool tableDirty = false;
+    int missing = 0;
+    for(int idx : needed){
+        if(chunkLayer[idx] >= 0) continue;
+        // Free layer first, else the least recently needed one not needed this frame
+        int layer = -1;
+        for(int l = 0; l < layerCapacity; ++l){
+            if(layerChunk[l] < 0) { layer = l; break; }
+            if(layerUsed[l] != frameStamp && (layer < 0 || layerUsed[l] < layerUsed[layer])) layer = l;
+        }
+        if(layer < 0) { ++missing; continue; }
+
+        if(layerChunk[layer] >= 0) chunkLayer[layerChunk[layer]] = -1;
+        layerChunk[layer] = idx;
+        chunkLayer[idx] = layer;
+        layerUsed[layer] = frameStamp;
+        const TerrainChunk* chunk = map.getChunkAtGrid(idx % layersX, idx / layersX);
+        uploadLayer(*chunk, layer, {0, 0, layerSize-1, layerSize-1});
+        tableDirty = true;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    if(tableDirty){
+        glBindTexture(GL_TEXTURE_2D, layerTable);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, layersX, layersZ, GL_RED_INTEGER, GL_INT, chunkLayer.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    lastStats.residentChunks = 0;
+    for(int c : layerChunk) if(c >= 0) ++lastStats.residentChunks;
+    lastStats.missingChunks = missing;
+    if(missing && !reportedShortage){
+        std::cerr << "[CDLOD] " << needed.size() << " chunks need full resolution but only " << layerCapacity
+                  << " layers are available; the rest use the 1/" << (1 << farShift) << " copy" << std::endl;
+        reportedShortage = true;
+    }
+}
+
+void CdlodRenderer::nodeBounds(TerrainMap& map, int level, int x, int z, glm::vec3& bmin, glm::vec3& bmax) const
+{
+    const int sizeCells = gridDim << level;
+    const int x0 = x*sizeCells, z0 = z*sizeCells;
+    const int x1 = std::min(x0 + sizeCells, worldCellsX) - 1, z1 = std::min(z0 + sizeCells, worldCellsZ) - 1;
+
+    // Fold the height ranges of every chunk the node overlaps
+    float lo = std::numeric_limits<float>::max(), hi = -std::numeric_limits<float>::max();
+    for(int gz = z0 / chunkCells; gz <= z1 / chunkCells; ++gz){
+        for(int gx = x0 / chunkCells; gx <= x1 / chunkCells; ++gx){
+            TerrainChunk* chunk = map.getChunkAtGrid(gx, gz);
+            if(!chunk) { lo = std::min(lo, 0.0f); hi = std::max(hi, 0.0f); continue; }
+            chunk->heightPyramid().rangeMinMax(x0 - gx*chunkCells, z0 - gz*chunkCells,
+                                               x1 - gx*chunkCells, z1 - gz*chunkCells, lo, hi);
+        }
+    }
+    if(lo > hi) lo = hi = 0.0f;
+
+    bmin = glm::vec3(x0 * cellSize, lo, z0 * cellSize);
+    bmax = glm::vec3((x1 + 1) * cellSize, hi, (z1 + 1) * cellSize);
+}
+
+static bool inRange(const glm::vec3& bmin, const glm::vec3& bmax, const glm::vec3& p, float radius)
+{
+    glm::vec3 d = glm::clamp(p, bmin, bmax) - p;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+bool CdlodRenderer::selectNode(TerrainMap& map, int level, int x, int z, const glm::vec3& camPos)
+{
+    const int sizeCells = gridDim << level;
+    // Entirely off the map: nothing to draw, and nothing the parent has to cover either
+    if(x*sizeCells >= worldCellsX || z*sizeCells >= worldCellsZ) return true;
+
+    ++lastStats.nodesVisited;
+    glm::vec3 bmin, bmax;
+    nodeBounds(map, level, x, z, bmin, bmax);
+    // Invisible: nothing to draw, and the parent mustn't draw this area either
+    if(cullFrustum && !cullFrustum->intersectsBox(bmin, bmax)) { ++lastStats.nodesCulled; return true; }
+    if(!inRange(bmin, bmax, camPos, ranges[level])) return false;
+
+    if(level == 0 || !inRange(bmin, bmax, camPos, ranges[level-1])){
+        selected.push_back({level, x, z, 15});
+        return true;
+    }
+
+    // Children out of their own range are drawn here, at this node's resolution
+    int mask = 0;
+    for(int c = 0; c < 4; ++c)
+        if(!selectNode(map, level - 1, x*2 + (c & 1), z*2 + (c >> 1), camPos)) mask |= 1 << c;
+    if(mask) selected.push_back({level, x, z, mask});
+    return true;
+}
+
+void CdlodRenderer::select(TerrainMap& map, const glm::vec3& camPos, float detailDistance, const Frustum* frustum)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    lastStats = CdlodStats();
+    selected.clear();
+
+    chunkCells = map.getChunkSize() - 1;
+    cellSize = map.getCellSize();
+    worldCellsX = map.gridWidth() * chunkCells;
+    worldCellsZ = map.gridDepth() * chunkCells;
+    if(chunkCells <= 0 || worldCellsX <= 0 || worldCellsZ <= 0) return;
+
+    int rootLevel = 0;
+    while((gridDim << rootLevel) < std::max(worldCellsX, worldCellsZ)) ++rootLevel;
+
+    // A ring has to hold a whole leaf node for the morph to finish before the next level takes over
+    ranges.resize(rootLevel + 1);
+    ranges[0] = std::max(detailDistance, 2.0f * gridDim * cellSize);
+    for(int l = 1; l <= rootLevel; ++l) ranges[l] = ranges[l-1] * 2.0f;
+    ranges[rootLevel] = std::numeric_limits<float>::max();
+
+    cullFrustum = frustum;
+    selectNode(map, rootLevel, 0, 0, camPos);
+    cullFrustum = nullptr;
+    updateResidency(map);
+    lastStats.farShift = farShift;
+
+    const int quadTris = (gridDim / 2) * (gridDim / 2) * 2;
+    for(const Node& n : selected){
+        ++lastStats.nodesDrawn;
+        for(int q = 0; q < 4; ++q) if(n.quadMask & (1 << q)) lastStats.triangles += quadTris;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    lastStats.selectMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void CdlodRenderer::drawSelected(Shader& shader)
+{
+    glBindVertexArray(vao);
+    for(const Node& n : selected){
+        const float scale = (1 << n.level) * cellSize;   // world units per mesh quad
+        shader.setVec2("uNodeOffset", n.x * gridDim * scale, n.z * gridDim * scale);
+        shader.setFloat("uNodeScale", scale);
+
+        // The root's ring is unbounded, so it never morphs
+        const float big = 1e30f;
+        float end = n.level + 1 < (int)ranges.size() ? ranges[n.level] : big;
+        float begin = n.level > 0 ? ranges[n.level-1] : 0.0f;
+        if(end >= big) shader.setVec2("uMorph", big, 2.0f * big);
+        else           shader.setVec2("uMorph", begin + (end - begin) * kMorphStart, end);
+
+        if(n.quadMask == 15){
+            glDrawElements(GL_TRIANGLES, quadCount * 4, GL_UNSIGNED_INT, nullptr);
+            continue;
+        }
+        GLsizei counts[4];
+        const void* offsets[4];
+        int parts = 0;
+        for(int q = 0; q < 4; ++q){
+            if(!(n.quadMask & (1 << q))) continue;
+            counts[parts] = quadCount;
+            offsets[parts] = (const void*)((size_t)q * quadCount * sizeof(uint32_t));
+            ++parts;
+        }
+        glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, parts);
+    }
+    glBindVertexArray(0);
+}
+
+void CdlodRenderer::render(Shader& shader)
+{
+    if(!farHeights || !vao || selected.empty()) return;
+
+    shader.setInt("uHeights", 0);
+    shader.setInt("uChunkLayer", 1);
+    shader.setInt("uFarHeights", 2);
+    shader.setInt("uFarShift", farShift);
+    shader.setInt("uChunksX", layersX);
+    shader.setInt("uChunksZ", layersZ);
+    shader.setInt("uChunkCells", chunkCells);
+    shader.setInt("uMeshDim", gridDim);
+    shader.setFloat("uCellSize", cellSize);
+    shader.setVec2("uWorldSize", worldCellsX * cellSize, worldCellsZ * cellSize);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightArray);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, layerTable);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, farHeights);
+
+    drawSelected(shader);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
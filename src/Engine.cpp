@@ -6,14 +6,11 @@ Engine::Engine()
     Initialize();
 
 
-    heightMapShader = new Shader("shaders/hmap.vs","shaders/hmap.fs", "shaders/hmap.g");
-    heightMapColorShader = new Shader("shaders/hmap_color.vs","shaders/hmap_color.fs");
+    terrainShaders = new ShaderVariants("shaders/hmap.vs","shaders/hmap.fs", "shaders/hmap.g");
+    cdlodShaders = new ShaderVariants("shaders/cdlod.vs","shaders/hmap.fs", "shaders/hmap.g", "#define CDLOD\n");
     terrainMap = new TerrainMap(2,2,GRID_SIZE, CELL_SIZE);
     terrainMap->build();
-    buildCircle(ringVerts, 1.0f);
-    GenCircleGL();
-
-    CreateFrameBuffer();
+    cdlod = new CdlodRenderer();
 }
 
 void Engine::Initialize()
@@ -67,7 +64,7 @@ void Engine::Start()
         ImVec2 imgPos = RenderGUI(); // now it returns the top-left of the image inside window
         ImGui::Render();
         
-        BindFramebuffer();
+        viewportTarget.bind(renderWidth, renderHeight);
 
         // --- Picking ---
         SDL_GetWindowSize(win,&ScreenWidth,&ScreenHeight);
@@ -83,7 +80,12 @@ void Engine::Start()
         glm::mat4 VP = Projection*View; 
         glm::mat4 invVP = glm::inverse(VP);
         bool hasHit = false;
-        glm::vec3 hit;
+        glm::vec3 hit(0.0f);
+
+        if(runPickBenchmark){
+            runPickingBenchmark(*terrainMap, invVP);
+            runPickBenchmark = false;
+        }
         
 
         if(insideImage){
@@ -95,40 +97,28 @@ void Engine::Start()
 
 
             glm::vec3 ro = glm::vec3(p0); glm::vec3 rd = glm::normalize(glm::vec3(p1-p0));
-            // hasHit = terrainChunk->rayHeightmapIntersect(ro, rd, 4000.0f, hit);
- 
-            hasHit = false;
-            float closestT = 1e9f;
-            for (auto& chunk : terrainMap->GetChunks()) 
-            {
-                glm::vec3 localRo = ro - chunk->position;  // move ray origin into chunk space
-                glm::vec3 tmpHitLocal;
-
-                if (chunk->rayHeightmapIntersect(localRo, rd, 4000.0f, tmpHitLocal)) {
-                    glm::vec3 tmpHitWorld = tmpHitLocal + chunk->position; // convert back to world
-                    float t = glm::length(tmpHitWorld - ro);
-                    if (t < closestT) {
-                        closestT = t;
-                        hit = tmpHitWorld;
-                        hasHit = true;
-                    }
-                }
-            }
+            hasHit = terrainMap->raycast(ro, rd, 4000.0f, hit);
 
 
             // --- Brush apply ---
-            if(hasHit){
-                // if(lmb){terrainChunk->applyBrush(brush, hit, shift);}
-                // if(mmb){terrainChunk->applyBrush(brush, hit, false);}
-                if (lmb) { terrainMap->applyBrush(brush, hit, shift); }
+            if(hasHit && lmb){
+                float dabWeight = stroke.update(hit, dt, brush, strokeDabs);
+                terrainMap->applyStroke(brush, strokeDabs, dabWeight, shift);
             }
         }
+        if(!lmb || !hasHit) stroke.end();
+
 
 
+        Frustum frustum(Projection * View);
+        const Frustum* cull = useFrustumCulling ? &frustum : nullptr;
 
         // terrainChunk->updateMeshIfDirty();
-        terrainMap->updateDirtyChunks();
+        // CDLOD keeps its own height copy, the arena meshes only matter when they're drawn
+        if(!useCdlod) terrainMap->updateDirtyChunks(cull);
         // --- Render ---
+        // Timed from here, so sculpt uploads above don't count against the render scale
+        dynRes.beginFrame();
         glClearColor(0.52f,0.75f,0.95f,1);
         glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
@@ -136,70 +126,41 @@ void Engine::Start()
         glm::mat4 MVP = Projection * View * Model;
         glm::mat3 NrmM = glm::mat3(1.0f);
             
-        heightMapShader->use();
-        heightMapShader->setMat4("uMVP", MVP);
-        heightMapShader->setBool("uFlatShading", flatshade);
-        heightMapShader->setMat4("uModel", Model);
-        heightMapShader->setMat3("uNrmM", NrmM);
-        heightMapShader->setVec3("uCamPos", cam.pos);
-        // terrainChunk->Render(wire);
-        terrainMap->render(wire);
-
-        // Draw brush ring at hit position
-        if(hasHit){
-            std::vector<glm::vec3> ring; buildCircle(ring, brush.radius, 96);
-            // update ring VBO with scaled circle at hit.y
-            // for(auto& v : ring){ v.y = 0.0f; }
-            
-            glm::mat4 Mring = glm::mat4(1.0f); // identity
-
-            if(projectCircle){
-
-                for(auto& v : ring)
-                {
-                    
-                    // v.y += terrain->getHeightAt(v.x,v.z);
-                    float worldX = v.x + hit.x;
-                    float worldZ = v.z + hit.z;
-                    TerrainChunk* tempChunk = terrainMap->getChunkAt(glm::vec3(worldX,0.0f,worldZ));
-                    if (tempChunk) {
-                        // Compute local coordinates relative to the chunk
-                        glm::vec3 local = glm::vec3(worldX, 0.0f, worldZ) - tempChunk->position;
-                        v.y = tempChunk->getHeightAt(local.x, local.z) + tempChunk->circleOffset;
-                    } else {
-                        v.y = 0.0f;
-                    }
-                    
-                    // update vertex to world-space XZ
-                    v.x = worldX;
-                    v.z = worldZ;
-                }                
-            }
-            else
-            {
-                for(auto& v : ring){ v.y = 0.0f; }
-                Mring = glm::translate(glm::mat4(1.0f), glm::vec3(hit.x, hit.y + 0.05f, hit.z));
-            }
-
-            glBindBuffer(GL_ARRAY_BUFFER, ringVBO);
-            glBufferData(GL_ARRAY_BUFFER, ring.size()*sizeof(glm::vec3), ring.data(), GL_DYNAMIC_DRAW);
-
-
-            // glm::mat4 VP = P*V; 
-
-            heightMapColorShader->use();
-            heightMapColorShader->setMat4("uVP", VP);
-            heightMapColorShader->setMat4("uM", Mring);
-            heightMapColorShader->setVec4("uColor", glm::vec4(0.0f,0.0f,0.0f,1.0f));
-            
-
-            glBindVertexArray(ringVAO);
-            glDrawArrays(GL_LINE_LOOP, 0, (GLint)ring.size());
-            glBindVertexArray(0);
+        // One upload for everything the terrain programs share this frame, brush cursor included
+        FrameData frame;
+        frame.viewProj = VP;
+        frame.mvp = MVP;
+        frame.model = Model;
+        frame.setNormalMatrix(NrmM);
+        frame.camPos = glm::vec4(cam.pos, 1.0f);
+        frame.lightDir = glm::vec4(glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)), 0.0f);
+        frame.setBrush(hit, hasHit ? brush.radius : 0.0f, brush.Falloff, (int)brush.mode, shift);
+        frameUniforms.upload(frame);
+
+        // Only the permutation in use is compiled, and the geometry stage only for wireframe
+        unsigned features = 0;
+        if(flatshade) features |= ShaderVariants::FlatShading;
+        if(wire)      features |= ShaderVariants::Wireframe;
+        Shader* terrainShader;
+        if(useCdlod){
+            cdlod->sync(*terrainMap);
+            cdlod->select(*terrainMap, cam.pos, cdlodDetailDistance, cull);
+            terrainShader = &cdlodShaders->get(features);
+        } else {
+            if(useLod) terrainMap->selectLods(cam.pos, EditorWindowHeight, glm::radians(cam.fov), lodPixelError);
+            else       terrainMap->resetLods();
+            if(terrainMap->getRenderMode() == TerrainRenderMode::CompactVertex) features |= ShaderVariants::CompactVertex;
+            if(terrainMap->getRenderMode() == TerrainRenderMode::HeightTexture) features |= ShaderVariants::HeightTexture;
+            terrainShader = &terrainShaders->get(features);
         }
+        terrainShader->use();
+        // terrainChunk->Render(wire);
+        if(useCdlod) cdlod->render(*terrainShader);
+        else         terrainMap->render(*terrainShader, cull);
 
 
-        UnbindFramebuffer();
+        dynRes.endFrame();
+        RenderTarget::unbind();
 
           // Render ImGui
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -209,22 +170,6 @@ void Engine::Start()
 
 }
 
-void Engine::buildCircle(std::vector<glm::vec3>& out, float radius, int segments){
-    out.clear(); out.reserve(segments);
-    for(int i=0;i<segments;++i){
-        float a = (i/(float)segments)*6.2831853f;
-        out.emplace_back(radius*cosf(a), 0.0f, radius*sinf(a));
-    }
-}
-
-void Engine::GenCircleGL()
-{
-    glGenVertexArrays(1, &ringVAO); glGenBuffers(1, &ringVBO);
-    glBindVertexArray(ringVAO); glBindBuffer(GL_ARRAY_BUFFER, ringVBO);
-    glBufferData(GL_ARRAY_BUFFER, ringVerts.size()*sizeof(glm::vec3), ringVerts.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0); glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,(void*)0); glBindVertexArray(0);
-}
-
 void Engine::HandleInput(float dt)
 {
     // int mx=0,my=0;
@@ -251,8 +196,9 @@ void Engine::HandleInput(float dt)
             if(e.key.keysym.sym==SDLK_f){ wire=!wire; }
             // if(e.key.keysym.sym==SDLK_r){ terrainChunk->resetHeightMap();}
             // if(e.key.keysym.sym==SDLK_F5){ terrainChunk->saveHMap("tile.hmap"); std::cout<<"Saved tile.hmap\n"; }
-            if(e.key.keysym.sym==SDLK_F5){ terrainMap->save("saved");}
-            if(e.key.keysym.sym==SDLK_F9){ terrainMap->load("saved");} 
+            // F5/F9: world archive; with Shift, the per-chunk folder layout
+            if(e.key.keysym.sym==SDLK_F5){ if(shift) terrainMap->exportFolder("saved"); else terrainMap->save("world.twa"); }
+            if(e.key.keysym.sym==SDLK_F9){ if(shift) terrainMap->importFolder("saved"); else terrainMap->load("world.twa"); } 
             // if(e.key.keysym.sym==SDLK_F9){ terrainChunk->loadHMap("tile.hmap"); std::cout<<"Loaded tile.hmap\n"; } 
         }
         
@@ -278,55 +224,6 @@ void Engine::HandleInput(float dt)
 
 }
 
-void Engine::CreateFrameBuffer()
-{
-    glGenFramebuffers(1, &FBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-
-	glGenTextures(1, &texture_id);
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, ScreenWidth, ScreenHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id, 0);
-
-	glGenRenderbuffers(1, &RBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, RBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, ScreenWidth, ScreenHeight);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, RBO);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!\n";
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-}
-
-void Engine::RescaleFramebuffer(float width, float height)
-{
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id, 0);
-
-	glBindRenderbuffer(GL_RENDERBUFFER, RBO);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, RBO);
-}
-
-void Engine::BindFramebuffer()
-{
-	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-}
-
-// here we unbind our framebuffer
-void Engine::UnbindFramebuffer()
-{
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
 ImVec2 Engine::RenderGUI()
 {
     ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
@@ -341,20 +238,23 @@ ImVec2 Engine::RenderGUI()
     EditorWindowWidth = ImGui::GetContentRegionAvail().x;
     EditorWindowHeight = ImGui::GetContentRegionAvail().y;
 
-    // rescale framebuffer
-    RescaleFramebuffer(EditorWindowWidth, EditorWindowHeight);
-    glViewport(0, 0, EditorWindowWidth, EditorWindowHeight);
+    // Storage follows the window size only; the render scale just shrinks the viewport inside it
+    viewportTarget.resize((int)EditorWindowWidth, (int)EditorWindowHeight);
+    renderWidth = std::max(1, (int)roundf(viewportTarget.width() * dynRes.scale()));
+    renderHeight = std::max(1, (int)roundf(viewportTarget.height() * dynRes.scale()));
+    float u = renderWidth / (float)viewportTarget.width();
+    float v = renderHeight / (float)viewportTarget.height();
 
     // get correct image position **inside the window**
     ImVec2 imgPos = ImGui::GetCursorScreenPos();
 
-    // add image
+    // add image, stretching the rendered corner over the whole panel
     ImGui::GetWindowDrawList()->AddImage(
-        (ImTextureID)(intptr_t)texture_id,
+        (ImTextureID)(intptr_t)viewportTarget.colorTexture(),
         imgPos,
         ImVec2(imgPos.x + EditorWindowWidth, imgPos.y + EditorWindowHeight),
-        ImVec2(0,1),
-        ImVec2(1,0)
+        ImVec2(0,v),
+        ImVec2(u,0)
     );
 
     ImGui::End();
@@ -373,18 +273,56 @@ ImVec2 Engine::RenderGUI()
     ImGui::SeparatorText("Status");
     if(ImGui::Button("Toggle Wireframe")) { wire = !wire; }
     ImGui::Checkbox("Flat Shading", &flatshade);
-    ImGui::Checkbox("Project Circle", &projectCircle);
+    const char* vertexFormats[] = {"Full (32 B)", "Compact (8 B)", "Height Texture"};
+    int currentFormat = static_cast<int>(terrainMap->getRenderMode());
+    if (ImGui::Combo("Vertex Format", &currentFormat, vertexFormats, IM_ARRAYSIZE(vertexFormats))) {
+        terrainMap->setRenderMode(static_cast<TerrainRenderMode>(currentFormat));
+    }
+    ImGui::Checkbox("Dynamic Resolution", &dynRes.enabled);
+    if (dynRes.enabled) {
+        ImGui::SliderFloat("Frame Budget (ms)", &dynRes.budgetMs, 4.0f, 33.0f);
+        ImGui::SliderFloat("Min Render Scale", &dynRes.minScale, 0.25f, 1.0f);
+    }
+    ImGui::Text("Viewport: %dx%d (%.0f%%), GPU %.2f ms", renderWidth, renderHeight, dynRes.scale() * 100.0f, dynRes.lastGpuMs());
+    ImGui::Checkbox("Frustum Culling", &useFrustumCulling);
+    ImGui::Checkbox("CDLOD Renderer", &useCdlod);
+    if (useCdlod) {
+        const CdlodStats& cs = cdlod->stats();
+        ImGui::SliderFloat("CDLOD Detail Distance", &cdlodDetailDistance, 25.0f, 2000.0f);
+        ImGui::Text("Nodes: %d drawn / %d visited (%.3f ms)", cs.nodesDrawn, cs.nodesVisited, cs.selectMs);
+        ImGui::Text("Nodes culled: %d", cs.nodesCulled);
+        ImGui::Text("Triangles: %lld", cs.triangles);
+        ImGui::Text("Full-res chunks: %d resident / %d missing (far 1/%d)", cs.residentChunks, cs.missingChunks, 1 << cs.farShift);
+    } else {
+        ImGui::Checkbox("Geomipmapping", &useLod);
+        if (useLod) ImGui::SliderFloat("LOD Pixel Error", &lodPixelError, 0.25f, 16.0f);
+        ImGui::Text("Triangles: %lld", terrainMap->lastTriangleCount());
+        ImGui::Text("Chunks: %d visible / %d culled", terrainMap->lastVisibleCount(), terrainMap->lastCulledCount());
+    }
 
 
     //--------------------------------------------------------------------
     ImGui::SeparatorText("Brush Settings");
     ImGui::SliderFloat("Brush Radius", &brush.radius, 0.1f, 100.0f);
     ImGui::SliderFloat("Brush Strength", &brush.strength, 0.01f, 10.0f);
+    ImGui::SliderFloat("Brush Spacing", &brush.spacing, 0.05f, 1.0f);
     const char* brushModes[] = {"Raise/Lower", "Smooth", "Flat"};
     int currentBrushMode = static_cast<int>(brush.mode); // keep track of selection
     if (ImGui::Combo("Brush Mode", &currentBrushMode, brushModes, IM_ARRAYSIZE(brushModes))) {
         brush.mode = static_cast<BrushMode>(currentBrushMode);
     }
+    if (brush.mode == BrushMode::Smooth) {
+        const char* smoothFilters[] = {"Box", "Gaussian"};
+        int currentFilter = static_cast<int>(brush.smoothFilter);
+        if (ImGui::Combo("Smooth Filter", &currentFilter, smoothFilters, IM_ARRAYSIZE(smoothFilters))) {
+            brush.smoothFilter = static_cast<SmoothFilter>(currentFilter);
+        }
+        ImGui::SliderInt("Smooth Radius", &brush.smoothRadius, 1, 8);
+    }
+    //--------------------------------------------------------------------
+    ImGui::SeparatorText("Benchmarks");
+    if(ImGui::Button("Run Picking Benchmark")) { runPickBenchmark = true; }
+
     //--------------------------------------------------------------------
     ImGui::SeparatorText("Keybinds");
     ImGui::Text("[F] Wireframe toggle");
@@ -0,0 +1,398 @@
+#include "HeightPyramid.hpp"
+#include "TerrainChunk.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define PICK_SSE2 1
+#endif
+
+// Level shapes for a chunk of cells x cells, nothing allocated yet
+std::vector<HeightPyramid::Level> HeightPyramid::makeLevels(int cells)
+{
+    std::vector<Level> out;
+    int w = cells, h = cells;
+    for(;;){
+        Level lvl;
+        lvl.w = w; lvl.h = h;
+        out.push_back(std::move(lvl));
+        if(w == 1 && h == 1) break;
+        w = (w + 1) / 2; h = (h + 1) / 2;
+    }
+    return out;
+}
+
+void HeightPyramid::build(const HeightMap& hm)
+{
+    cells = hm.size - 1;
+    levels = makeLevels(cells);
+    for(size_t l = 0; l < levels.size(); ++l){
+        Level& lvl = levels[l];
+        lvl.minH.resize((size_t)lvl.w*lvl.h);
+        lvl.maxH.resize((size_t)lvl.w*lvl.h);
+        if(l >= 1 && (int)l < kLodLevels) lvl.errH.resize((size_t)lvl.w*lvl.h);
+    }
+    firstStored = 0;
+    lazySource = nullptr;
+    incomplete.store(false, std::memory_order_relaxed);
+
+    update(hm, 0, 0, hm.size-1, hm.size-1);
+}
+
+// Layout: uint32 cells, uint32 first level, float lodErr[kLodLevels], then minH and maxH of every
+// level from the first one up to the root
+size_t HeightPyramid::writeSummary(void* dst, size_t capacity) const
+{
+    if(levels.empty()) return 0;
+    size_t bytes = 2*sizeof(uint32_t) + sizeof(lodErr);
+    int first = (int)levels.size();
+    while(first > firstStored){
+        const Level& lvl = levels[first - 1];
+        size_t more = 2 * (size_t)lvl.w*lvl.h * sizeof(float);
+        if(bytes + more > capacity) break;
+        bytes += more;
+        --first;
+    }
+    if(first == (int)levels.size()) return 0;
+
+    unsigned char* out = (unsigned char*)dst;
+    uint32_t u[2] = {(uint32_t)cells, (uint32_t)first};
+    std::memcpy(out, u, sizeof(u)); out += sizeof(u);
+    std::memcpy(out, lodErr, sizeof(lodErr)); out += sizeof(lodErr);
+    for(size_t l = first; l < levels.size(); ++l){
+        const Level& lvl = levels[l];
+        size_t n = (size_t)lvl.w*lvl.h * sizeof(float);
+        std::memcpy(out, lvl.minH.data(), n); out += n;
+        std::memcpy(out, lvl.maxH.data(), n); out += n;
+    }
+    return bytes;
+}
+
+bool HeightPyramid::readSummary(const HeightMap& hm, const void* src, size_t bytes)
+{
+    const unsigned char* in = (const unsigned char*)src;
+    uint32_t u[2];
+    if(bytes < sizeof(u) + sizeof(lodErr)) return false;
+    std::memcpy(u, in, sizeof(u));
+    if((int)u[0] != hm.size - 1) return false;
+
+    std::vector<Level> fresh = makeLevels(hm.size - 1);
+    const int first = (int)u[1];
+    size_t expect = sizeof(u) + sizeof(lodErr);
+    if(first < 0 || first >= (int)fresh.size()) return false;
+    for(size_t l = first; l < fresh.size(); ++l) expect += 2 * (size_t)fresh[l].w*fresh[l].h * sizeof(float);
+    if(bytes != expect) return false;
+
+    in += sizeof(u);
+    std::memcpy(lodErr, in, sizeof(lodErr)); in += sizeof(lodErr);
+    for(size_t l = first; l < fresh.size(); ++l){
+        Level& lvl = fresh[l];
+        size_t n = (size_t)lvl.w*lvl.h;
+        lvl.minH.assign((const float*)in, (const float*)in + n); in += n * sizeof(float);
+        lvl.maxH.assign((const float*)in, (const float*)in + n); in += n * sizeof(float);
+    }
+    cells = hm.size - 1;
+    levels = std::move(fresh);
+    firstStored = first;
+    lazySource = &hm;
+    // Even with every level stored, errH still has to be rebuilt before the first edit
+    incomplete.store(true, std::memory_order_release);
+    return true;
+}
+
+// Builds the levels below firstStored from hm. The stored levels already match hm, so they're left
+// alone and other threads can keep reading them meanwhile.
+void HeightPyramid::completeLevels() const
+{
+    std::lock_guard<std::mutex> lock(completeLock);
+    if(!incomplete.load(std::memory_order_relaxed)) return;
+    const HeightMap& hm = *lazySource;
+
+    for(int l = 0; l < (int)levels.size(); ++l){
+        Level& lvl = levels[l];
+        if(l < firstStored){
+            lvl.minH.resize((size_t)lvl.w*lvl.h);
+            lvl.maxH.resize((size_t)lvl.w*lvl.h);
+        }
+        if(l >= 1 && l < kLodLevels) lvl.errH.resize((size_t)lvl.w*lvl.h);
+    }
+    Level& leaf = levels[0];
+    for(int z = 0; z < cells; ++z){
+        const float* r0 = hm.row(z);
+        const float* r1 = hm.row(z + 1);
+        for(int x = 0; x < cells; ++x){
+            float a = r0[x], b = r0[x+1], c = r1[x], d = r1[x+1];
+            leaf.minH[(size_t)z*leaf.w + x] = std::min(std::min(a, b), std::min(c, d));
+            leaf.maxH[(size_t)z*leaf.w + x] = std::max(std::max(a, b), std::max(c, d));
+        }
+    }
+    for(int l = 1; l < (int)levels.size(); ++l){
+        if(l < firstStored) refreshLevel(l, 0, 0, levels[l].w - 1, levels[l].h - 1);
+        // errH isn't part of the summary, lodErr (its maxima) is
+        if(!levels[l].errH.empty()) refreshError(hm, l, 0, 0, levels[l].w - 1, levels[l].h - 1);
+    }
+    incomplete.store(false, std::memory_order_release);
+}
+
+void HeightPyramid::update(const HeightMap& hm, int x0, int z0, int x1, int z1)
+{
+    if(levels.empty()) return;
+    if(incomplete.load(std::memory_order_acquire)) completeLevels();
+
+    // A sample belongs to the cells on both of its sides
+    x0 = std::max(x0 - 1, 0); z0 = std::max(z0 - 1, 0);
+    x1 = std::min(x1, cells - 1); z1 = std::min(z1, cells - 1);
+    if(x1 < x0 || z1 < z0) return;
+
+    Level& leaf = levels[0];
+    for(int z = z0; z <= z1; ++z){
+        const float* r0 = hm.row(z);
+        const float* r1 = hm.row(z + 1);
+        for(int x = x0; x <= x1; ++x){
+            float a = r0[x], b = r0[x+1], c = r1[x], d = r1[x+1];
+            leaf.minH[(size_t)z*leaf.w + x] = std::min(std::min(a, b), std::min(c, d));
+            leaf.maxH[(size_t)z*leaf.w + x] = std::max(std::max(a, b), std::max(c, d));
+        }
+    }
+
+    for(size_t l = 1; l < levels.size(); ++l){
+        x0 >>= 1; z0 >>= 1; x1 >>= 1; z1 >>= 1;
+        refreshLevel((int)l, x0, z0, x1, z1);
+        if(!levels[l].errH.empty()) refreshError(hm, (int)l, x0, z0, x1, z1);
+    }
+
+    // Per-level maxima; a level too coarse for this chunk size just inherits the one below
+    for(int l = 1; l < kLodLevels; ++l){
+        float e = lodErr[l-1];
+        if(l < (int)levels.size())
+            for(float v : levels[l].errH) e = std::max(e, v);
+        lodErr[l] = e;
+    }
+}
+
+void HeightPyramid::refreshError(const HeightMap& hm, int l, int x0, int z0, int x1, int z1) const
+{
+    Level& lvl = levels[l];
+    const int span = 1 << l;
+    for(int z = z0; z <= z1; ++z){
+        int sz0 = z*span, sz1 = std::min((z+1)*span, cells);
+        for(int x = x0; x <= x1; ++x){
+            int sx0 = x*span, sx1 = std::min((x+1)*span, cells);
+            float h00 = hm.at(sx0,sz0), h10 = hm.at(sx1,sz0);
+            float h01 = hm.at(sx0,sz1), h11 = hm.at(sx1,sz1);
+            float iw = 1.0f / (sx1 - sx0), id = 1.0f / (sz1 - sz0);
+
+            // Distance to the two triangles the coarse quad is drawn with, split like buildMesh
+            float err = 0.0f;
+            for(int pz = sz0; pz <= sz1; ++pz){
+                const float* row = hm.row(pz);
+                float v = (pz - sz0) * id;
+                for(int px = sx0; px <= sx1; ++px){
+                    float u = (px - sx0) * iw;
+                    float lerp = (u + v <= 1.0f) ? h00 + u*(h10 - h00) + v*(h01 - h00)
+                                                 : h11 + (1.0f - u)*(h01 - h11) + (1.0f - v)*(h10 - h11);
+                    err = std::max(err, fabsf(row[px] - lerp));
+                }
+            }
+            lvl.errH[(size_t)z*lvl.w + x] = err;
+        }
+    }
+}
+
+void HeightPyramid::refreshLevel(int l, int x0, int z0, int x1, int z1) const
+{
+    const Level& src = levels[l-1];
+    Level& dst = levels[l];
+    for(int z = z0; z <= z1; ++z){
+        for(int x = x0; x <= x1; ++x){
+            float lo =  std::numeric_limits<float>::max();
+            float hi = -std::numeric_limits<float>::max();
+            for(int cz = 2*z; cz <= std::min(2*z+1, src.h-1); ++cz){
+                for(int cx = 2*x; cx <= std::min(2*x+1, src.w-1); ++cx){
+                    lo = std::min(lo, src.minH[(size_t)cz*src.w + cx]);
+                    hi = std::max(hi, src.maxH[(size_t)cz*src.w + cx]);
+                }
+            }
+            dst.minH[(size_t)z*dst.w + x] = lo;
+            dst.maxH[(size_t)z*dst.w + x] = hi;
+        }
+    }
+}
+
+bool HeightPyramid::rangeMinMax(int x0, int z0, int x1, int z1, float& lo, float& hi) const
+{
+    if(levels.empty()) return false;
+    x0 = std::max(x0, 0); z0 = std::max(z0, 0);
+    x1 = std::min(x1, cells - 1); z1 = std::min(z1, cells - 1);
+    if(x1 < x0 || z1 < z0) return false;
+    rangeNode((int)levels.size() - 1, 0, 0, x0, z0, x1, z1, lo, hi);
+    return true;
+}
+
+void HeightPyramid::rangeNode(int l, int x, int z, int x0, int z0, int x1, int z1, float& lo, float& hi) const
+{
+    need(l);
+    const Level& lvl = levels[l];
+    if(x >= lvl.w || z >= lvl.h) return;
+    int nx0 = x << l, nz0 = z << l;
+    int nx1 = std::min(((x+1) << l), cells) - 1, nz1 = std::min(((z+1) << l), cells) - 1;
+    if(nx1 < x0 || nz1 < z0 || nx0 > x1 || nz0 > z1) return;
+
+    // Fully covered nodes answer from their stored range, partial ones split
+    if(l == 0 || (nx0 >= x0 && nz0 >= z0 && nx1 <= x1 && nz1 <= z1)){
+        lo = std::min(lo, lvl.minH[(size_t)z*lvl.w + x]);
+        hi = std::max(hi, lvl.maxH[(size_t)z*lvl.w + x]);
+        return;
+    }
+    for(int c = 0; c < 4; ++c)
+        rangeNode(l - 1, x*2 + (c & 1), z*2 + (c >> 1), x0, z0, x1, z1, lo, hi);
+}
+
+static const float kBoxPad = 1e-3f;
+
+bool rayBox(const glm::vec3& ro, const glm::vec3& invRd, const glm::vec3& bmin, const glm::vec3& bmax,
+            float t0, float t1, float& tEnter, float& tExit)
+{
+    for(int a = 0; a < 3; ++a){
+        float n = (bmin[a] - ro[a]) * invRd[a];
+        float f = (bmax[a] - ro[a]) * invRd[a];
+        if(n > f) std::swap(n, f);
+        // NaN from 0*inf (ray lying exactly on a slab plane) is ignored by the comparisons
+        if(n > t0) t0 = n;
+        if(f < t1) t1 = f;
+        if(t0 > t1) return false;
+    }
+    tEnter = t0; tExit = t1;
+    return true;
+}
+
+int rayBox4(const RayPacket4& p, const glm::vec3& bmin, const glm::vec3& bmax,
+            float t0, float t1, float tEnter[4], float tExit[4])
+{
+#ifdef PICK_SSE2
+    const float* o[3]   = {p.ox, p.oy, p.oz};
+    const float* inv[3] = {p.ix, p.iy, p.iz};
+    const __m128 negInf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    const __m128 posInf = _mm_set1_ps( std::numeric_limits<float>::infinity());
+    __m128 vt0 = _mm_set1_ps(t0), vt1 = _mm_set1_ps(t1);
+    for(int a = 0; a < 3; ++a){
+        __m128 vo = _mm_loadu_ps(o[a]), vi = _mm_loadu_ps(inv[a]);
+        __m128 n = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmin[a]), vo), vi);
+        __m128 f = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bmax[a]), vo), vi);
+        // Lanes lying exactly on a slab plane give NaN; like rayBox, they don't clip the interval
+        __m128 ord = _mm_cmpord_ps(n, f);
+        __m128 lo = _mm_min_ps(n, f), hi = _mm_max_ps(n, f);
+        lo = _mm_or_ps(_mm_and_ps(ord, lo), _mm_andnot_ps(ord, negInf));
+        hi = _mm_or_ps(_mm_and_ps(ord, hi), _mm_andnot_ps(ord, posInf));
+        vt0 = _mm_max_ps(vt0, lo);
+        vt1 = _mm_min_ps(vt1, hi);
+    }
+    _mm_storeu_ps(tEnter, vt0);
+    _mm_storeu_ps(tExit, vt1);
+    return _mm_movemask_ps(_mm_cmple_ps(vt0, vt1));
+#else
+    int mask = 0;
+    for(int i = 0; i < 4; ++i){
+        glm::vec3 ro(p.ox[i], p.oy[i], p.oz[i]), invRd(p.ix[i], p.iy[i], p.iz[i]);
+        if(rayBox(ro, invRd, bmin, bmax, t0, t1, tEnter[i], tExit[i])) mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+// Two-sided Moller-Trumbore
+static bool rayTriangle(const glm::vec3& ro, const glm::vec3& rd,
+                        const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t)
+{
+    const float eps = 1e-6f;
+    glm::vec3 e1 = b - a, e2 = c - a;
+    glm::vec3 p = glm::cross(rd, e2);
+    float det = glm::dot(e1, p);
+    if(fabsf(det) < 1e-12f) return false;
+    float inv = 1.0f / det;
+    glm::vec3 s = ro - a;
+    float u = glm::dot(s, p) * inv;
+    if(u < -eps || u > 1.0f + eps) return false;
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(rd, q) * inv;
+    if(v < -eps || u + v > 1.0f + eps) return false;
+    t = glm::dot(e2, q) * inv;
+    return true;
+}
+
+bool rayCellIntersect(const HeightMap& hm, int cx, int cz, const glm::vec3& ro, const glm::vec3& rd,
+                      float tMin, float tMax, float& tHit)
+{
+    float x0 = cx*hm.cell, x1 = (cx+1)*hm.cell;
+    float z0 = cz*hm.cell, z1 = (cz+1)*hm.cell;
+    glm::vec3 p00(x0, hm.at(cx,  cz),   z0);
+    glm::vec3 p10(x1, hm.at(cx+1,cz),   z0);
+    glm::vec3 p01(x0, hm.at(cx,  cz+1), z1);
+    glm::vec3 p11(x1, hm.at(cx+1,cz+1), z1);
+
+    // Same split as buildMesh: (i0,i2,i1) and (i1,i2,i3)
+    float best = tMax, t;
+    bool found = false;
+    if(rayTriangle(ro, rd, p00, p01, p10, t) && t >= tMin && t <= best){ best = t; found = true; }
+    if(rayTriangle(ro, rd, p10, p01, p11, t) && t >= tMin && t <= best){ best = t; found = true; }
+    if(found) tHit = best;
+    return found;
+}
+
+bool HeightPyramid::raycast(const HeightMap& hm, const glm::vec3& ro, const glm::vec3& rd, float maxDist,
+                            float& tHit, PickStats* stats) const
+{
+    if(levels.empty()) return false;
+
+    glm::vec3 invRd(1.0f / rd.x, 1.0f / rd.y, 1.0f / rd.z);
+    float best = maxDist;
+    bool found = false;
+
+    struct Node { int l, x, z; float tEnter, tExit; };
+    Node stack[4 * 32];
+    int sp = 0;
+
+    auto push = [&](int l, int x, int z){
+        need(l);
+        const Level& lvl = levels[l];
+        if(x >= lvl.w || z >= lvl.h) return;
+        int span = 1 << l;
+        // Boxes are padded so hits on a flat node or a shared edge aren't lost to rounding
+        glm::vec3 bmin(x*span*hm.cell - kBoxPad, lvl.minH[(size_t)z*lvl.w + x] - kBoxPad, z*span*hm.cell - kBoxPad);
+        glm::vec3 bmax(std::min((x+1)*span, cells)*hm.cell + kBoxPad, lvl.maxH[(size_t)z*lvl.w + x] + kBoxPad,
+                       std::min((z+1)*span, cells)*hm.cell + kBoxPad);
+        if(stats) ++stats->nodesVisited;
+        float tEnter, tExit;
+        if(!rayBox(ro, invRd, bmin, bmax, 0.0f, best, tEnter, tExit)) return;
+        stack[sp++] = {l, x, z, tEnter, tExit};
+    };
+
+    push((int)levels.size()-1, 0, 0);
+    while(sp > 0){
+        Node n = stack[--sp];
+        if(n.tEnter >= best) continue;
+
+        if(n.l == 0){
+            float t;
+            if(stats) ++stats->cellsTested;
+            if(rayCellIntersect(hm, n.x, n.z, ro, rd, n.tEnter - kBoxPad, std::min(n.tExit + kBoxPad, best), t) && t < best){
+                best = t;
+                found = true;
+            }
+            continue;
+        }
+
+        // Children pushed far-to-near so the one the ray reaches first is popped first
+        int nx = rd.x >= 0 ? 0 : 1, nz = rd.z >= 0 ? 0 : 1;
+        int cl = n.l - 1, bx = n.x*2, bz = n.z*2;
+        push(cl, bx + (1-nx), bz + (1-nz));
+        push(cl, bx + nx,     bz + (1-nz));
+        push(cl, bx + (1-nx), bz + nz);
+        push(cl, bx + nx,     bz + nz);
+    }
+
+    if(found) tHit = best;
+    return found;
+}
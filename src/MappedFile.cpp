@@ -0,0 +1,75 @@
+#include "MappedFile.hpp"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER len;
+    if(!GetFileSizeEx(file, &len) || len.QuadPart == 0) { CloseHandle(file); return false; }
+
+    // PAGE_WRITECOPY + FILE_MAP_COPY is the Windows spelling of MAP_PRIVATE
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if(!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);   // the view keeps the mapping alive
+    if(!view) { std::cerr << "MapViewOfFile failed for " << path << "\n"; return false; }
+
+    base = (unsigned char*)view;
+    bytes = (size_t)len.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(base) UnmapViewOfFile(base);
+    base = nullptr;
+    bytes = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); return false; }
+
+    // PROT_WRITE on a read-only fd is allowed for MAP_PRIVATE, the writes never go back to the file
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);            // the mapping keeps its own reference to the file
+    if(view == MAP_FAILED) { std::cerr << "mmap failed for " << path << "\n"; return false; }
+
+    base = (unsigned char*)view;
+    bytes = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(base) munmap(base, bytes);
+    base = nullptr;
+    bytes = 0;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "RenderTarget.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+bool RenderTarget::resize(int width, int height)
+{
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+    if(fbo && width == w && height == h) return false;
+
+    if(!fbo) {
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(1, &color);
+        glGenRenderbuffers(1, &depth);
+    }
+    w = width;
+    h = height;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    // LINEAR also does the upscale when the viewport renders below full resolution
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!\n";
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    return true;
+}
+
+void RenderTarget::destroy()
+{
+    if(depth) glDeleteRenderbuffers(1, &depth);
+    if(color) glDeleteTextures(1, &color);
+    if(fbo) glDeleteFramebuffers(1, &fbo);
+    fbo = color = depth = 0;
+    w = h = 0;
+}
+
+void RenderTarget::bind(int renderW, int renderH) const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, std::min(std::max(renderW, 1), w), std::min(std::max(renderH, 1), h));
+}
+
+void RenderTarget::unbind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    if(queries[0]) glDeleteQueries(kQueries, queries);
+}
+
+void DynamicResolution::beginFrame()
+{
+    if(!queries[0]) glGenQueries(kQueries, queries);
+
+    // Collect every finished measurement, oldest first
+    for(int i = 0; i < kQueries; ++i) {
+        int q = (next + i) % kQueries;
+        if(!pending[q]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &ns);
+        pending[q] = false;
+        adjust(ns * 1e-6f);
+    }
+
+    // Slot still in flight: skip timing this frame rather than wait for the GPU
+    timing = !pending[next];
+    if(timing) glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void DynamicResolution::endFrame()
+{
+    if(!timing) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[next] = true;
+    next = (next + 1) % kQueries;
+    timing = false;
+}
+
+void DynamicResolution::adjust(float ms)
+{
+    gpuMs = ms;
+    if(!enabled) { current = 1.0f; return; }
+
+    // Dead band between 75% and 100% of the budget
+    if(ms <= budgetMs && ms >= 0.75f * budgetMs) return;
+    float target = current * std::sqrt(0.9f * budgetMs / std::max(ms, 0.01f));
+    target = std::min(std::max(target, minScale), 1.0f);
+    current += (target - current) * 0.25f;
+}
@@ -0,0 +1,101 @@
+#include "TerrainArena.hpp"
+#include "TerrainIndexBuffer.hpp"
+#include <iostream>
+
+bool TerrainArena::build(int slotCount, int gridSize, TerrainRenderMode mode, const TerrainIndexBuffer& indices)
+{
+    destroy();
+    if(slotCount <= 0 || gridSize <= 0) return false;
+
+    if(mode == TerrainRenderMode::HeightTexture) {
+        GLint maxLayers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        if(slotCount > maxLayers) {
+            std::cerr << "[TerrainArena] " << slotCount << " chunks exceed GL_MAX_ARRAY_TEXTURE_LAYERS (" << maxLayers << ")" << std::endl;
+            return false;
+        }
+    }
+
+    renderMode = mode;
+    slots = slotCount;
+    size = gridSize;
+    slotVerts = gridSize * gridSize;
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    if(mode == TerrainRenderMode::HeightTexture) {
+        // No attributes: the VAO only carries the shared index buffer
+        vertexSize = 0;
+        glGenTextures(1, &heightArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, heightArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, gridSize, gridSize, slotCount, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    } else {
+        vertexSize = mode == TerrainRenderMode::CompactVertex ? sizeof(VertexCompact) : sizeof(VertexPNUV);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)slotCount * slotVerts * vertexSize, nullptr, GL_DYNAMIC_DRAW);
+
+        GLsizei stride = (GLsizei)vertexSize;
+        if(mode == TerrainRenderMode::CompactVertex) {
+            glEnableVertexAttribArray(0); glVertexAttribPointer(0,1,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(VertexCompact,h));
+            glEnableVertexAttribArray(1); glVertexAttribPointer(1,2,GL_SHORT,GL_TRUE,stride,(void*)offsetof(VertexCompact,n));
+        } else {
+            glEnableVertexAttribArray(0); glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(VertexPNUV,p));
+            glEnableVertexAttribArray(1); glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(VertexPNUV,n));
+            glEnableVertexAttribArray(2); glVertexAttribPointer(2,2,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(VertexPNUV,uv));
+        }
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.handle());
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void TerrainArena::destroy()
+{
+    if(heightArray) glDeleteTextures(1, &heightArray);
+    if(vbo) glDeleteBuffers(1, &vbo);
+    if(vao) glDeleteVertexArrays(1, &vao);
+    vao = vbo = heightArray = 0;
+    slots = slotVerts = size = 0;
+}
+
+void TerrainArena::uploadVertices(int slot, size_t firstVertex, const void* data, size_t bytes)
+{
+    if(!vbo || slot < 0 || slot >= slots) return;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(((size_t)slot * slotVerts + firstVertex) * vertexSize), bytes, data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// ROW_LENGTH lets the sub-rect stride over the source rows, so heights go up straight from hm
+void TerrainArena::uploadHeights(int slot, int x, int z, int w, int h, const float* src, int rowLength)
+{
+    if(!heightArray || slot < 0 || slot >= slots) return;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightArray);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, z, slot, w, h, 1, GL_RED, GL_FLOAT, src);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TerrainArena::draw(const std::vector<GLsizei>& counts, const std::vector<const void*>& offsets,
+                        const std::vector<GLint>& baseVertices) const
+{
+    if(!vao || counts.empty()) return;
+    glBindVertexArray(vao);
+    if(heightArray) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, heightArray);
+    }
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+                                  (GLsizei)counts.size(), baseVertices.data());
+    glBindVertexArray(0);
+}
@@ -1,192 +1,324 @@
 #include "TerrainChunk.hpp"
+#include "BrushKernels.hpp"
 #include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 
 
-void TerrainChunk::buildMesh() {
-    std::vector<VertexPNUV> verts(hm.size * hm.size);
-
-    for(int z = 0; z < hm.size; ++z) {
-        for(int x = 0; x < hm.size; ++x) {
-        VertexPNUV& v = verts[z*hm.size + x];
-        v.p = glm::vec3(position.x + x*hm.cell, hm.at(x,z), position.z + z*hm.cell);
-        v.n = hm.normalAt(x,z);
-        v.uv = glm::vec2(x / float(hm.size-1), z / float(hm.size-1));
-        }
+// Octahedral normal encoding (Cigolle et al.), folded around the Y axis since terrain is Y-up
+static void octEncode(const glm::vec3& n, int16_t out[2]) {
+    float s = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float ex = n.x / s, ez = n.z / s;
+    if(n.y < 0.0f) {
+        float wx = (1.0f - fabsf(ez)) * (ex >= 0.0f ? 1.0f : -1.0f);
+        float wz = (1.0f - fabsf(ex)) * (ez >= 0.0f ? 1.0f : -1.0f);
+        ex = wx; ez = wz;
     }
+    out[0] = (int16_t)lrintf(glm::clamp(ex, -1.0f, 1.0f) * 32767.0f);
+    out[1] = (int16_t)lrintf(glm::clamp(ez, -1.0f, 1.0f) * 32767.0f);
+}
 
+void TerrainChunk::buildMesh(TerrainArena& target, int targetSlot) {
+    arena = &target;
+    slot = targetSlot;
+    dirtyRect = {0, 0, hm.size-1, hm.size-1};
+}
+
+void TerrainChunk::fillVertex(int x, int z, VertexPNUV& v) const {
+    v.p = glm::vec3(position.x + x*hm.cell, hm.at(x,z), position.z + z*hm.cell);
+    v.n = hm.normalAt(x,z);
+    v.uv = glm::vec2(x / float(hm.size-1), z / float(hm.size-1));
+}
 
-    // Build indices
-    std::vector<uint32_t> idx;
-    idx.reserve((hm.size-1)*(hm.size-1)*6);
-    for(int z = 0; z < hm.size-1; ++z) {
-        for(int x = 0; x < hm.size-1; ++x) {
-            uint32_t i0 = z*hm.size + x;
-            uint32_t i1 = i0 + 1;
-            uint32_t i2 = i0 + hm.size;
-            uint32_t i3 = i2 + 1;
-            idx.insert(idx.end(), {i0, i2, i1, i1, i2, i3});
+void TerrainChunk::fillVertex(int x, int z, VertexCompact& v) const {
+    v.h = hm.at(x,z);
+    octEncode(hm.normalAt(x,z), v.n);
+}
+
+template<typename Vertex>
+void TerrainChunk::fillRect(const DirtyRect& r, std::vector<Vertex>& out) const {
+    int w = r.x1 - r.x0 + 1;
+    out.resize((size_t)w * (r.z1 - r.z0 + 1));
+    for(int z = r.z0; z <= r.z1; ++z) {
+        Vertex* dst = &out[(size_t)(z - r.z0) * w];
+        for(int x = r.x0; x <= r.x1; ++x) {
+            fillVertex(x, z, dst[x - r.x0]);
         }
     }
+}
 
-    // Create VAO/VBO/IBO if necessary
-    if(!mesh.vao) glGenVertexArrays(1,&mesh.vao);
-    if(!mesh.vbo) glGenBuffers(1,&mesh.vbo);
-    if(!mesh.ibo) glGenBuffers(1,&mesh.ibo);
+void TerrainChunk::markDirty(int x0, int z0, int x1, int z1) {
+    x0 = std::max(x0-1, 0); z0 = std::max(z0-1, 0);
+    x1 = std::min(x1+1, hm.size-1); z1 = std::min(z1+1, hm.size-1);
+    if(x1 < x0 || z1 < z0) return;
+    dirtyRect.expand(x0, z0, x1, z1);
+    heightEdits.expand(x0, z0, x1, z1);
+    unsaved = true;
+}
 
-    glBindVertexArray(mesh.vao);
+// Only rebuild the rows/columns a brush touched; a full-width rect goes up as one contiguous block
+template<typename Vertex>
+void TerrainChunk::uploadRect(const DirtyRect& r, std::vector<Vertex>& scratch) {
+    fillRect(r, scratch);
+    int w = r.x1 - r.x0 + 1;
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    glBufferData(GL_ARRAY_BUFFER, verts.size()*sizeof(VertexPNUV), verts.data(), GL_DYNAMIC_DRAW);
+    if(w == hm.size) {
+        arena->uploadVertices(slot, (size_t)r.z0*hm.size, scratch.data(), scratch.size()*sizeof(Vertex));
+    } else {
+        for(int z = r.z0; z <= r.z1; ++z) {
+            arena->uploadVertices(slot, (size_t)z*hm.size + r.x0, &scratch[(size_t)(z - r.z0) * w], w*sizeof(Vertex));
+        }
+    }
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size()*sizeof(uint32_t), idx.data(), GL_STATIC_DRAW);
+void TerrainChunk::updateMeshIfDirty() {
+    // Nothing to patch before buildMesh, which queues the whole chunk
+    if(dirtyRect.empty() || !arena) return;
+
+    const DirtyRect& r = dirtyRect;
+    switch(arena->mode()) {
+        case TerrainRenderMode::HeightTexture:
+            // Heights go up straight from hm, no CPU vertex loop
+            arena->uploadHeights(slot, r.x0, r.z0, r.x1 - r.x0 + 1, r.z1 - r.z0 + 1, hm.row(r.z0) + r.x0, hm.size);
+            break;
+        case TerrainRenderMode::CompactVertex: uploadRect(r, uploadCompact);    break;
+        default:                               uploadRect(r, uploadVerts);      break;
+    }
+    dirtyRect.clear();
+}
 
-    GLsizei stride = sizeof(VertexPNUV);
-    glEnableVertexAttribArray(0); glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(VertexPNUV,p));
-    glEnableVertexAttribArray(1); glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(VertexPNUV,n));
-    glEnableVertexAttribArray(2); glVertexAttribPointer(2,2,GL_FLOAT,GL_FALSE,stride,(void*)offsetof(VertexPNUV,uv));
+void TerrainChunk::resetHeightMap()
+{
+    std::fill(hm.data, hm.data + hm.count(), 0.0f); 
+    pyramid.build(hm);
+    markAllDirty(); 
+}
 
-    glBindVertexArray(0);
+// One instantiation per mode/falloff pair so the row loops carry no per-cell mode tests.
+// All dabs of a pass are applied row by row over their union, in dab order, so RaiseLower
+// gives bit-identical results to applying the dabs one after another. Flat targets are sampled
+// before the pass, so where dabs overlap the last one wins with its pre-pass height.
+template<BrushMode Mode, bool Falloff>
+static void runBrushKernel(HeightMap& hm, const DirtyRect& area, const std::vector<BrushDab>& dabs)
+{
+    for(int z = area.z0; z <= area.z1; ++z){
+        float* row = hm.row(z);
+        for(const BrushDab& d : dabs){
+            if(z < d.z0 || z > d.z1) continue;
+            float dz = z * hm.cell - d.hitZ;
+            float dz2 = dz*dz;
+
+            if constexpr (Mode == BrushMode::RaiseLower) {
+                raiseLowerRow<Falloff>(row, d.x0, d.x1, hm.cell, d.hitX, dz2, d.radius, d.amount);
+            }
+            else if constexpr (Mode == BrushMode::Flat) {
+                flattenRow(row, d.x0, d.x1, hm.cell, d.hitX, dz2, d.radius, d.value);
+            }
+        }
+    }
+}
 
-    mesh.indexCount = (GLsizei)idx.size();
-    dirty = false;
+// Cells of row z that dab d may cover, as [xa,xb] (one cell of slack either side of the exact
+// circle chord; callers still test the squared distance). False if the row misses the dab.
+static bool dabRowSpan(const BrushDab& d, int z, float cell, int& xa, int& xb)
+{
+    if(z < d.z0 || z > d.z1) return false;
+    float dz = z * cell - d.hitZ;
+    float h2 = d.radius*d.radius - dz*dz;
+    if(h2 < 0.0f) return false;
+    float hw = sqrtf(h2);
+    xa = std::max(d.x0, (int)floorf((d.hitX - hw) / cell));
+    xb = std::min(d.x1, (int)ceilf((d.hitX + hw) / cell));
+    return xa <= xb;
 }
 
+// Smooth: separable box/Gaussian filter of half-width k. The vertical pass reads the untouched
+// heights into a scratch copy of the footprint (plus horizontal halo), the horizontal pass reads
+// only that copy, so results no longer depend on iteration order. Taps outside the chunk are
+// dropped and the remaining weights renormalised, matching the old inBounds 3x3 average.
+// With several dabs the filter runs once over their union; a cell covered by c dabs is blended
+// by 1-(1-blend)^c, the same amount c separate passes would move a flat-filtered cell.
+// Both passes only run over the span of each row the dabs actually cover, and each dab only
+// visits its own chord of the row, so a long diagonal stroke costs its swept area, not its
+// bounding box times the dab count.
+static void runSmoothKernel(HeightMap& hm, const DirtyRect& area, const std::vector<BrushDab>& dabs,
+                            int k, SmoothFilter filter, std::vector<float>& scratch, std::vector<int>& spans)
+{
+    k = std::max(k, 1);
+    int sx0 = std::max(area.x0 - k, 0), sx1 = std::min(area.x1 + k, hm.size-1);
+    int sw = sx1 - sx0 + 1;             // scratch row width: footprint plus halo
+    int fw = area.x1 - area.x0 + 1;     // footprint row width
+    int rows = area.z1 - area.z0 + 1;
+
+    scratch.resize((size_t)sw*rows + 3*fw + 2*k+1);
+    float* tmp   = scratch.data();
+    float* acc   = tmp + (size_t)sw*rows;
+    float* normX = acc + fw;
+    float* keep  = normX + fw;
+    float* w     = keep + fw + k;       // w[-k..k]
+
+    float sigma = std::max(k * 0.5f, 0.5f);
+    for(int o = -k; o <= k; ++o)
+        w[o] = filter == SmoothFilter::Gaussian ? expf(-(o*o) / (2.0f*sigma*sigma)) : 1.0f;
+
+    // Covered span of every row: union of the dab chords
+    spans.assign((size_t)rows*2, 0);
+    for(int z = area.z0; z <= area.z1; ++z){
+        int lo = area.x1 + 1, hi = area.x0 - 1;
+        for(const BrushDab& d : dabs){
+            int xa, xb;
+            if(!dabRowSpan(d, z, hm.cell, xa, xb)) continue;
+            lo = std::min(lo, xa); hi = std::max(hi, xb);
+        }
+        spans[(size_t)(z - area.z0)*2] = lo;
+        spans[(size_t)(z - area.z0)*2 + 1] = hi;
+    }
 
-void TerrainChunk::updateMeshIfDirty() {
-    if(!dirty) return;
-
-    std::vector<VertexPNUV> verts(hm.size * hm.size);
-    for(int z = 0; z < hm.size; ++z) {
-        for(int x = 0; x < hm.size; ++x) {
-            VertexPNUV& v = verts[z*hm.size + x];
-            v.p = glm::vec3(position.x + x*hm.cell, hm.at(x,z), position.z + z*hm.cell);
-            v.n = hm.normalAt(x,z);
-            v.uv = glm::vec2(x / float(hm.size-1), z / float(hm.size-1));
+    // Vertical pass: tmp row = weighted sum of source rows z-k..z+k, over the span plus halo
+    for(int z = area.z0; z <= area.z1; ++z){
+        int lo = spans[(size_t)(z - area.z0)*2], hi = spans[(size_t)(z - area.z0)*2 + 1];
+        if(hi < lo) continue;
+        int vx0 = std::max(lo - k, 0), vw = std::min(hi + k, hm.size-1) - vx0 + 1;
+        float* t = tmp + (size_t)(z - area.z0)*sw + (vx0 - sx0);
+        std::fill(t, t + vw, 0.0f);
+        float norm = 0.0f;
+        for(int o = -k; o <= k; ++o){
+            int zz = z + o;
+            if(zz < 0 || zz >= hm.size) continue;
+            axpyRow(t, hm.row(zz) + vx0, w[o], vw);
+            norm += w[o];
         }
+        float inv = 1.0f / norm;
+        for(int i = 0; i < vw; ++i) t[i] *= inv;
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, verts.size()*sizeof(VertexPNUV), verts.data());
-    dirty = false;
-}
+    for(int x = area.x0; x <= area.x1; ++x){
+        float norm = 0.0f;
+        for(int o = -k; o <= k; ++o) if(x + o >= 0 && x + o < hm.size) norm += w[o];
+        normX[x - area.x0] = 1.0f / norm;
+    }
 
-void TerrainChunk::Render(bool wire){
-    if (wire) {
-        // 1) Depth pre-pass (fill, no color)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-        drawMesh();
-
-        // 2) Wire pass
-        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-
-        glEnable(GL_POLYGON_OFFSET_LINE);
-        glPolygonOffset(-1.0f, -1.0f);
-
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDepthFunc(GL_LEQUAL);
-        drawMesh();
-
-        // restore
-        glDisable(GL_POLYGON_OFFSET_LINE);
-        glDisable(GL_CULL_FACE);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_LESS);
-    } else {
-        // Just a filled render
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        drawMesh();
+    // Horizontal pass per row, then blend inside the brush circles
+    for(int z = area.z0; z <= area.z1; ++z){
+        int lo = spans[(size_t)(z - area.z0)*2], hi = spans[(size_t)(z - area.z0)*2 + 1];
+        if(hi < lo) continue;
+        int n = hi - lo + 1;
+
+        std::fill(keep, keep + n, 1.0f);
+        bool any = false;
+        float dz = z * hm.cell;
+        for(const BrushDab& d : dabs){
+            int xa, xb;
+            if(!dabRowSpan(d, z, hm.cell, xa, xb)) continue;
+            float dz2 = (dz - d.hitZ) * (dz - d.hitZ);
+            float r2 = d.radius * d.radius;
+            for(int x = xa; x <= xb; ++x){
+                float dx = x * hm.cell - d.hitX;
+                if(dx*dx + dz2 <= r2) { keep[x - lo] *= 1.0f - d.blend; any = true; }
+            }
+        }
+        if(!any) continue;
+
+        const float* t = tmp + (size_t)(z - area.z0)*sw;
+        std::fill(acc, acc + n, 0.0f);
+        for(int o = -k; o <= k; ++o){
+            int xa = std::max(lo, -o), xb = std::min(hi, hm.size-1 - o);
+            if(xb < xa) continue;
+            axpyRow(acc + (xa - lo), t + (xa + o - sx0), w[o], xb - xa + 1);
+        }
+
+        float* row = hm.row(z);
+        for(int x = lo; x <= hi; ++x){
+            float kp = keep[x - lo];
+            if(kp == 1.0f) continue;
+            float avg = acc[x - lo] * normX[x - area.x0];
+            row[x] = glm::mix(row[x], avg, 1.0f - kp);
+        }
     }
 }
 
-void TerrainChunk::drawMesh() {
+bool TerrainChunk::makeDab(const Brush& b, const glm::vec3& hit, float weight, bool lower, BrushDab& d) const
+{
+    int cx = (int)roundf(hit.x / hm.cell);
+    int cz = (int)roundf(hit.z / hm.cell);
 
-    // updateMeshIfDirty();
-    glBindVertexArray(mesh.vao);
+    int rCells = (int)ceilf(b.radius / hm.cell);
+    float sgn = lower ? -1.0f : 1.0f;
 
-    glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, nullptr);
-    
-    glBindVertexArray(0);
+    d.x0 = std::max(cx - rCells, 0); d.x1 = std::min(cx + rCells, hm.size-1);
+    d.z0 = std::max(cz - rCells, 0); d.z1 = std::min(cz + rCells, hm.size-1);
+    if(d.x1 < d.x0 || d.z1 < d.z0) return false;
+
+    d.hitX = hit.x; d.hitZ = hit.z;
+    d.radius = b.radius;
+    d.amount = sgn * b.strength * 0.1f * weight;
+    float blend = glm::clamp(b.strength*0.2f, 0.0f, 1.0f);
+    d.blend = weight == 1.0f ? blend : 1.0f - powf(1.0f - blend, weight);
+    d.value = 0.0f;
+
+    if(b.mode == BrushMode::Flat)
+    {
+        // Sampled once per dab, before the pass, so cells written by it don't shift the target
+        float currentHeight = getHeightAt(hit.x, hit.z);
+        float step = 0.1f * weight;
+        if(lower || !b.Falloff) {
+            // Step down (shift) or up (ctrl) from the height under the cursor; optional clamp at 0
+            if(currentHeight <= 0.0f) return false;
+            d.value = lower ? currentHeight - step : currentHeight + step;
+        } else {
+            // Flatten normally
+            d.value = currentHeight;
+        }
+    }
+    return true;
 }
 
-void TerrainChunk::resetHeightMap()
+void TerrainChunk::applyBrush(const Brush &b, const glm::vec3 &hit, bool lower)
 {
-    std::fill(hm.h.begin(), hm.h.end(), 0.0f); 
-    dirty=true; 
+    dabs.clear();
+    BrushDab d;
+    if(makeDab(b, hit, 1.0f, lower, d)) dabs.push_back(d);
+    runDabs(b);
 }
 
-void TerrainChunk::applyBrush(const Brush &b, const glm::vec3 &hit, bool lower)
+void TerrainChunk::applyDabs(const Brush& b, const std::vector<glm::vec3>& worldHits, float weight, bool lower)
 {
+    dabs.clear();
+    BrushDab d;
+    for(const glm::vec3& hit : worldHits){
+        if(makeDab(b, hit - position, weight, lower, d)) dabs.push_back(d);
+    }
+    runDabs(b);
+}
 
-    int cx = (int)roundf(hit.x / hm.cell);
-    int cz = (int)roundf(hit.z / hm.cell);
+void TerrainChunk::runDabs(const Brush& b)
+{
+    if(dabs.empty()) return;
 
-    int rCells = (int)ceilf(b.radius / hm.cell);
-    // int rCells = (int)ceilf(b.radius / hm.cell);
-    float sgn = lower ? -1.0f : 1.0f;
+    DirtyRect area;
+    for(const BrushDab& d : dabs) area.expand(d.x0, d.z0, d.x1, d.z1);
 
-    for(int dz=-rCells; dz<=rCells; ++dz){
-        int z = cz + dz;
-        if(z < 0 || z >= hm.size) continue;   // bounds check
+    // Touched footprint; recorded up front so the upload only covers these rows
+    markDirty(area.x0, area.z0, area.x1, area.z1);
 
-        for(int dx=-rCells; dx<=rCells; ++dx){
-            int x = cx + dx;
-            if(x < 0 || x >= hm.size) continue; // bounds check
-            float wx = x * hm.cell;   // still chunk-local
-            float wz = z * hm.cell;   // chunk-local
-            float dist = glm::length(glm::vec2(wx - hit.x, wz - hit.z));
-            if(dist > b.radius) continue;
+    switch(b.mode)
+    {
+        case BrushMode::RaiseLower:
+            if(b.Falloff) runBrushKernel<BrushMode::RaiseLower, true>(hm, area, dabs);
+            else          runBrushKernel<BrushMode::RaiseLower, false>(hm, area, dabs);
+            break;
 
+        case BrushMode::Smooth:
+            runSmoothKernel(hm, area, dabs, b.smoothRadius, b.smoothFilter, smoothScratch, smoothSpans);
+            break;
 
-            if(b.mode == BrushMode::RaiseLower)
-            {
-                float falloff = b.Falloff ? 0.5f*(cosf(3.14159f*dist/b.radius)+1.0f) : 1.0f;
-                hm.at(x,z) += sgn * b.strength * falloff * 0.1f;
-                dirty = true;
-            }
-            else if(b.mode == BrushMode::Smooth)
-            {
-                float sum=0; int cnt=0;
-                for(int oz=-1; oz<=1; ++oz){
-                     for(int ox=-1; ox<=1; ++ox){
-                        int xx=x+ox, zz=z+oz;
-                        if(hm.inBounds(xx,zz)){
-                            sum+=hm.at(xx,zz); ++cnt; 
-                        } 
-                    }
-                }
-                float avg = sum / (float)cnt;
-                hm.at(x,z) = glm::mix(hm.at(x,z), avg, glm::clamp(b.strength*0.2f, 0.0f, 1.0f));
-                dirty=true;
-            }
-            else if(b.mode == BrushMode::Flat)
-            {
-                float currentHeight = getHeightAt(hit.x, hit.z); 
-                float step = 0.1f; // deltaTime if you want frame-independent
-                if(lower) {
-                    // Gradually reduce height
-                    if(currentHeight > 0.0f) {           // optional: clamp to 0 or some min
-                        hm.at(x,z) = currentHeight - step;
-                    }
-                } 
-                else if(!b.Falloff){
-                    if(currentHeight > 0.0f) {           // optional: clamp to 0 or some min
-                        hm.at(x,z) = currentHeight + step;
-                    }
-                }
-                else {
-                    // Flatten normally
-                    hm.at(x,z) = currentHeight;
-                }
-                
-                dirty=true;
-            }
-        }
+        case BrushMode::Flat:
+            runBrushKernel<BrushMode::Flat, false>(hm, area, dabs);
+            break;
     }
+
+    pyramid.update(hm, area.x0, area.z0, area.x1, area.z1);
 }
 
 float TerrainChunk::getHeightAt(float x, float z) const {
@@ -194,61 +326,112 @@ float TerrainChunk::getHeightAt(float x, float z) const {
 }
 
 
-bool TerrainChunk::rayHeightmapIntersect(const glm::vec3 &rayOrigin, const glm::vec3 &rayDistance, float maxDist, glm::vec3 &outHit)
+bool TerrainChunk::rayHeightmapIntersect(const glm::vec3 &rayOrigin, const glm::vec3 &rayDistance, float maxDist, glm::vec3 &outHit, PickStats* stats) const
 {
+    float t;
+    if(!pyramid.raycast(hm, rayOrigin, rayDistance, maxDist, t, stats)) return false;
+    outHit = rayOrigin + rayDistance * t;
+    return true;
+}
 
-    // Simple ray marching along ray; test when ray.y <= height(wx,wz)
-    float t = 0.0f; 
-    float step = hm.cell * 0.5f; // step ~ half cell
-    glm::vec3 p;
-
-    for(int i=0; i<2048 && t <= maxDist; ++i){
-        p = rayOrigin + rayDistance * t;
-        if(p.x < 0 || p.z < 0 || p.x > (hm.size-1)*hm.cell || p.z > (hm.size-1)*hm.cell){ t += step; continue; }
-        float h = hm.sampleHeight(p.x, p.z);
-        if(p.y <= h){
-            // refine with binary search
-            float t0 = t - step, t1 = t;
-            for(int j=0;j<8;++j){
-                float tm = 0.5f*(t0+t1);
-                glm::vec3 pm = rayOrigin + rayDistance*tm;
-                float hmH = hm.sampleHeight(pm.x, pm.z);
-                if(pm.y > hmH) t0 = tm;
-                else t1 = tm;
-            }
-            outHit = rayOrigin + rayDistance * t1; outHit.y = hm.sampleHeight(outHit.x, outHit.z);
+bool TerrainChunk::rayGridIntersect(const glm::vec3 &rayOrigin, const glm::vec3 &rayDistance, float maxDist, glm::vec3 &outHit, PickStats* stats) const
+{
+    const glm::vec3& ro = rayOrigin;
+    const glm::vec3& rd = rayDistance;
+    int cells = hm.size - 1;
+    float eps = 1e-4f * hm.cell;
+
+    // Clip to the chunk box first so the walk starts at the first cell the ray enters
+    glm::vec3 invRd(1.0f / rd.x, 1.0f / rd.y, 1.0f / rd.z);
+    glm::vec3 bmin(0.0f, pyramid.minHeight() - eps, 0.0f);
+    glm::vec3 bmax(cells * hm.cell, pyramid.maxHeight() + eps, cells * hm.cell);
+    float tEnter, tExit;
+    if(!rayBox(ro, invRd, bmin, bmax, 0.0f, maxDist, tEnter, tExit)) return false;
+
+    glm::vec3 p = ro + rd * tEnter;
+    int cx = glm::clamp((int)floorf(p.x / hm.cell), 0, cells - 1);
+    int cz = glm::clamp((int)floorf(p.z / hm.cell), 0, cells - 1);
+
+    // Amanatides-Woo stepping: t at which the ray crosses the next x / z cell line
+    const float inf = std::numeric_limits<float>::infinity();
+    int stepX = rd.x > 0 ? 1 : -1, stepZ = rd.z > 0 ? 1 : -1;
+    float tDeltaX = rd.x != 0 ? hm.cell / fabsf(rd.x) : inf;
+    float tDeltaZ = rd.z != 0 ? hm.cell / fabsf(rd.z) : inf;
+    float tMaxX = rd.x != 0 ? ((cx + (rd.x > 0 ? 1 : 0)) * hm.cell - ro.x) / rd.x : inf;
+    float tMaxZ = rd.z != 0 ? ((cz + (rd.z > 0 ? 1 : 0)) * hm.cell - ro.z) / rd.z : inf;
+
+    float tCell0 = tEnter;
+    for(;;){
+        float tCell1 = std::min(std::min(tMaxX, tMaxZ), tExit);
+        if(stats) ++stats->cellsTested;
+
+        float t;
+        if(rayCellIntersect(hm, cx, cz, ro, rd, tCell0 - eps, tCell1 + eps, t)){
+            outHit = ro + rd * t;
             return true;
         }
-        t += step;
+        if(tCell1 >= tExit) return false;
+
+        if(tMaxX < tMaxZ){ cx += stepX; tCell0 = tMaxX; tMaxX += tDeltaX; }
+        else             { cz += stepZ; tCell0 = tMaxZ; tMaxZ += tDeltaZ; }
+        if(cx < 0 || cz < 0 || cx >= cells || cz >= cells) return false;
     }
-    return false;
 }
 
 
 //Comments so i remember what is done here.
 bool TerrainChunk::saveHMap(const std::string& path){
-    //Open binary file
-    std::ofstream f(path, std::ios::binary);
-    if(!f) return false;
-    
+    namespace fs = std::filesystem;
+    size_t payloadBytes = hm.count()*sizeof(float);
+
+    //Write to a temp file first, so a failed save never leaves a half-written chunk behind
+    std::string tmpPath = path + ".tmp";
+    {
+        //Open binary file
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!f) return false;
+
+        //Get the designed header for this custom heightmap file
+        HMapHeader2 hdr = {};
+
+        //Write fileheader (arbitrary) as HMP2 to show what file it is
+        hdr.magic[0]='H';hdr.magic[1]='M';hdr.magic[2]='P';hdr.magic[3]='2';
+
+        //Writes what size the heightmap is and how big the cells are
+        hdr.size=hm.size;
+        hdr.cell=hm.cell;
+        hdr.gridX = gridX;
+        hdr.gridZ = gridZ;
+        hdr.payloadOffset = kHMapPageSize;
+        hdr.payloadBytes = payloadBytes;
+
+        //The coarse pyramid levels go in the padding, so loading doesn't have to rebuild them from every sample
+        std::vector<char> pad(kHMapPageSize - sizeof(hdr), 0);
+        hdr.pyramidBytes = (uint32_t)pyramid.writeSummary(pad.data(), pad.size());
+
+        //Header, the padding up to the first page, then the RAW heightmap dump
+        f.write((char*)&hdr, sizeof(hdr));
+        f.write(pad.data(), pad.size());
+        f.write((char*)hm.data, payloadBytes);
+        if(!f){ f.close(); std::error_code ec; fs::remove(tmpPath, ec); return false; }
+    }
 
-    //Get the designed header for this custom heightmap file
-    HMapHeader hdr;
-    
-    //Write fileheader (arbitrary) as HMP1 to show what file it is
-    hdr.magic[0]='H';hdr.magic[1]='M';hdr.magic[2]='P';hdr.magic[3]='1';
-    
-    //Writes what size the heightmap is and how big the cells are 
-    hdr.size=hm.size;
-    hdr.cell=hm.cell;
-    hdr.gridX = gridX;
-    hdr.gridZ = gridZ;
-    
-    //First write header
-    f.write((char*)&hdr, sizeof(hdr));
+#ifdef _WIN32
+    // Windows won't replace a file that is still mapped
+    if(hm.isMapped()) hm.own();
+#endif
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if(ec){
+        std::cerr << "Failed to replace " << path << ": " << ec.message() << "\n";
+        fs::remove(tmpPath, ec);
+        return false;
+    }
 
-    //Just RAW dump the heightmap data at the rest
-    f.write((char*)hm.h.data(), hm.h.size()*sizeof(float));
+    // The new file holds exactly hm, so view it: edited copy-on-write pages are released and the
+    // samples are file-backed again. Keeping the current storage is fine if mapping fails.
+    auto file = std::make_shared<MappedFile>();
+    if(file->open(path) && file->size() >= kHMapPageSize + payloadBytes) hm.view(std::move(file), kHMapPageSize);
     return true;
 }
 
@@ -256,45 +439,73 @@ bool TerrainChunk::saveHMap(const std::string& path){
 bool TerrainChunk::loadHMap(const std::string& path){
     auto start = std::chrono::high_resolution_clock::now();
     
-    //Open binary file
-    std::ifstream f(path, std::ios::binary);
-    if(!f) return false;
-    
-    //Get the header for this fileformat
-    HMapHeader hdr;
-    f.read((char*)&hdr, sizeof(hdr));
+    //Map the whole file, nothing is read until the pages are touched
+    auto file = std::make_shared<MappedFile>();
+    if(!file->open(path)) return false;
+    const unsigned char* bytes = file->data();
+    size_t payloadBytes = hm.count()*sizeof(float);
+
+    bool summarized = false;
 
     //Verify it is a valid file and format through the magic header
-    if(!(hdr.magic[0]=='H'&&hdr.magic[1]=='M'&&hdr.magic[2]=='P'&&hdr.magic[3]=='1')) return false;
-    
-    //Verify that the size is correct
-    if((int)hdr.size != hm.size){ std::cerr<<"Mismatched size in hmap.\n"; return false; }
-    
-    gridX = (int)hdr.gridX;
-    gridZ = (int)hdr.gridZ;
+    if(file->size() >= sizeof(HMapHeader2) && std::memcmp(bytes, "HMP2", 4) == 0) {
+        HMapHeader2 hdr;
+        std::memcpy(&hdr, bytes, sizeof(hdr));
+
+        //Verify that the size is correct and the payload is really there and aligned
+        if((int)hdr.size != hm.size){ std::cerr<<"Mismatched size in hmap.\n"; return false; }
+        if(hdr.payloadBytes != payloadBytes || hdr.payloadOffset % kHMapPageSize != 0 ||
+           hdr.payloadOffset > file->size() || payloadBytes > file->size() - hdr.payloadOffset){
+            std::cerr<<"Truncated or corrupt hmap: "<<path<<"\n"; return false;
+        }
+        gridX = (int)hdr.gridX;
+        gridZ = (int)hdr.gridZ;
+        hm.view(std::move(file), (size_t)hdr.payloadOffset);
+
+        //Take the saved pyramid summary if there is a valid one; the fine levels fill in on first use
+        summarized = hdr.pyramidBytes > 0 && sizeof(hdr) + hdr.pyramidBytes <= hdr.payloadOffset &&
+                     pyramid.readSummary(hm, bytes + sizeof(hdr), hdr.pyramidBytes);
+    }
+    else if(file->size() >= sizeof(HMapHeader) && std::memcmp(bytes, "HMP1", 4) == 0) {
+        HMapHeader hdr;
+        std::memcpy(&hdr, bytes, sizeof(hdr));
+
+        if((int)hdr.size != hm.size){ std::cerr<<"Mismatched size in hmap.\n"; return false; }
+        if(sizeof(hdr) + payloadBytes > file->size()){ std::cerr<<"Truncated hmap: "<<path<<"\n"; return false; }
+        gridX = (int)hdr.gridX;
+        gridZ = (int)hdr.gridZ;
+
+        //The HMP1 payload sits right after the 20-byte header and isn't float aligned, so copy it out
+        hm.copyFrom(bytes + sizeof(hdr));
+    }
+    else return false;
 
     position.x = gridX * (hm.size - 1) * hm.cell;
     position.z = gridZ * (hm.size - 1) * hm.cell;
     position.y = 0.0f; // default
 
-    //Resize height array
-    hm.h.resize(hm.size*hm.size);
-    f.read((char*)hm.h.data(), hm.h.size()*sizeof(float));
-    
-    dirty=true;
+    if(!summarized) pyramid.build(hm);
+    markAllDirty();
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     // Duration in microseconds
     auto duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 
-    std::cout << "[TerrainChunk] Heightmap loaded in " << duration_ms << " ms (" 
+    std::cout << "[TerrainChunk] Heightmap " << (hm.isMapped() ? "mapped" : "loaded") << " in " << duration_ms << " ms (" 
               << duration_us << " μs)." << std::endl;
- 
-    buildMesh();
     return true;
 }
 
+void TerrainChunk::viewHeights(std::shared_ptr<MappedFile> file, size_t byteOffset, int gx, int gz){
+    gridX = gx;
+    gridZ = gz;
+    position = glm::vec3(gridX * (hm.size - 1) * hm.cell, 0.0f, gridZ * (hm.size - 1) * hm.cell);
+    hm.view(std::move(file), byteOffset);
+    pyramid.build(hm);
+    markAllDirty();
+    unsaved = false;
+}
 
 bool TerrainChunk::contains(float wx, float wz){
 
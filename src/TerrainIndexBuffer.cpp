@@ -0,0 +1,114 @@
+#include "TerrainIndexBuffer.hpp"
+#include <cstdint>
+
+// Lattice sample positions of one level: multiples of stride, plus the last sample
+static std::vector<int> latticeOf(int gridSize, int stride)
+{
+    std::vector<int> p;
+    for(int i = 0; i < gridSize - 1; i += stride) p.push_back(i);
+    p.push_back(gridSize - 1);
+    return p;
+}
+
+// Emits one lattice quad with the same (i0,i2,i1) (i1,i2,i3) split the pickers assume.
+// Edge samples on a stitched side are first snapped down onto the coarser neighbour's lattice;
+// triangles that collapse in the process are dropped. When both sides of the short last quad are
+// snapped it turns concave at i0, and only the other diagonal keeps it from folding over.
+static void emitQuad(std::vector<uint32_t>& out, int gridSize, int stride, int mask,
+                     int x0, int z0, int x1, int z1)
+{
+    const int last = gridSize - 1, coarse = stride * 2;
+    auto snap = [&](int p){ return p == last ? p : (p / coarse) * coarse; };
+    auto vert = [&](int x, int z) -> uint32_t {
+        if((mask & TerrainIndexBuffer::EdgeNegZ) && z == 0)    x = snap(x);
+        if((mask & TerrainIndexBuffer::EdgePosZ) && z == last) x = snap(x);
+        if((mask & TerrainIndexBuffer::EdgeNegX) && x == 0)    z = snap(z);
+        if((mask & TerrainIndexBuffer::EdgePosX) && x == last) z = snap(z);
+        return (uint32_t)(z*gridSize + x);
+    };
+    uint32_t i0 = vert(x0, z0), i1 = vert(x1, z0), i2 = vert(x0, z1), i3 = vert(x1, z1);
+
+    // Twice the signed XZ area; negative for the winding buildMesh has always used
+    auto area = [&](uint32_t a, uint32_t b, uint32_t c){
+        long ax = a % gridSize, az = a / gridSize;
+        long bx = (long)(b % gridSize) - ax, bz = (long)(b / gridSize) - az;
+        long cx = (long)(c % gridSize) - ax, cz = (long)(c / gridSize) - az;
+        return bx*cz - bz*cx;
+    };
+    auto tri = [&](uint32_t a, uint32_t b, uint32_t c){
+        if(area(a, b, c) == 0) return;
+        out.push_back(a); out.push_back(b); out.push_back(c);
+    };
+    if(area(i0, i2, i1) <= 0 && area(i1, i2, i3) <= 0) {
+        tri(i0, i2, i1);
+        tri(i1, i2, i3);
+    } else {
+        tri(i0, i2, i3);
+        tri(i0, i3, i1);
+    }
+}
+
+void TerrainIndexBuffer::build(int gridSize)
+{
+    if(ibo && size == gridSize) return;
+
+    std::vector<uint32_t> idx;
+    ranges.clear();
+    lods = 0;
+    for(int lod = 0; lod < kMaxLods && (1 << lod) < gridSize - 1; ++lod){
+        const int stride = 1 << lod;
+        std::vector<int> lat = latticeOf(gridSize, stride);
+        const int n = (int)lat.size() - 1;                  // quads per side
+
+        Range r;
+        r.offset = idx.size() * sizeof(uint32_t);
+        for(int j = 1; j < n - 1; ++j)
+            for(int i = 1; i < n - 1; ++i)
+                emitQuad(idx, gridSize, stride, 0, lat[i], lat[j], lat[i+1], lat[j+1]);
+        r.count = (GLsizei)(idx.size() - r.offset / sizeof(uint32_t));
+        ranges.push_back(r);
+
+        for(int mask = 0; mask < 16; ++mask){
+            Range rr;
+            rr.offset = idx.size() * sizeof(uint32_t);
+            for(int j = 0; j < n; ++j){
+                for(int i = 0; i < n; ++i){
+                    if(i > 0 && i < n - 1 && j > 0 && j < n - 1) continue; // interior
+                    emitQuad(idx, gridSize, stride, mask, lat[i], lat[j], lat[i+1], lat[j+1]);
+                }
+            }
+            rr.count = (GLsizei)(idx.size() - rr.offset / sizeof(uint32_t));
+            ranges.push_back(rr);
+        }
+        ++lods;
+    }
+
+    if(!ibo) glGenBuffers(1, &ibo);
+    // The element binding is VAO state, so unbind first to leave the chunk VAOs alone
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size()*sizeof(uint32_t), idx.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    size = gridSize;
+}
+
+void TerrainIndexBuffer::destroy()
+{
+    if(ibo) glDeleteBuffers(1, &ibo);
+    ibo = 0; size = 0; lods = 0;
+    ranges.clear();
+}
+
+void TerrainIndexBuffer::appendDraw(int lod, int stitchMask, std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const
+{
+    const Range& a = interior(lod);
+    const Range& b = ring(lod, stitchMask & 15);
+    counts.push_back(a.count);  offsets.push_back((const void*)a.offset);
+    counts.push_back(b.count);  offsets.push_back((const void*)b.offset);
+}
+
+GLsizei TerrainIndexBuffer::triangleCount(int lod, int stitchMask) const
+{
+    return (interior(lod).count + ring(lod, stitchMask & 15).count) / 3;
+}
@@ -20,43 +20,188 @@ TerrainMap::TerrainMap(int chunksX, int chunksZ, int chunkSize, float cellSize)
          
         }
     }
+    rebuildGridIndex();
 }
 
-void TerrainMap::build() {
+void TerrainMap::rebuildGridIndex()
+{
+    chunkGrid.assign(chunksX * chunksZ, nullptr);
     for (auto& chunk : chunks) {
-        chunk->buildMesh();
+        if (chunk->gridX < 0 || chunk->gridZ < 0 || chunk->gridX >= chunksX || chunk->gridZ >= chunksZ) continue;
+        chunkGrid[chunk->gridZ * chunksX + chunk->gridX] = chunk.get();
+    }
+}
+
+void TerrainMap::build() {
+    // One index buffer for every chunk instead of an identical copy per chunk
+    indices.build(chunkSize);
+    // One slot per grid cell, so shaders can recover the chunk origin from the slot alone
+    if (!arena.build(chunksX * chunksZ, chunkSize, renderMode, indices)) return;
+    for (int i = 0; i < chunksX * chunksZ; ++i) {
+        if (chunkGrid[i]) chunkGrid[i]->buildMesh(arena, i);
+    }
+}
+
+void TerrainMap::setRenderMode(TerrainRenderMode mode) {
+    if (mode == renderMode) return;
+    renderMode = mode;
+    build();
+}
+
+void TerrainMap::collectBrushTargets(float minX, float minZ, float maxX, float maxZ) {
+    // Chunk gx spans [gx*span, (gx+1)*span] including its shared border samples,
+    // so it overlaps the brush for ceil(min/span)-1 <= gx <= floor(max/span)
+    float span = (chunkSize - 1) * cellSize;
+    int gx0 = std::max((int)ceilf(minX / span) - 1, 0);
+    int gz0 = std::max((int)ceilf(minZ / span) - 1, 0);
+    int gx1 = std::min((int)floorf(maxX / span), chunksX - 1);
+    int gz1 = std::min((int)floorf(maxZ / span), chunksZ - 1);
+
+    brushTargets.clear();
+    for (int gz = gz0; gz <= gz1; ++gz) {
+        for (int gx = gx0; gx <= gx1; ++gx) {
+            TerrainChunk* chunk = getChunkAtGrid(gx, gz);
+            if (!chunk) continue;
+            // Edits would be saved under a fresh checksum, so a corrupt payload must not get this far
+            verifyChunk(*chunk);
+            brushTargets.push_back(chunk);
+        }
     }
 }
 
+bool TerrainMap::verifyChunk(TerrainChunk& chunk) {
+    const size_t i = (size_t)chunk.gridZ * chunksX + chunk.gridX;
+    if (i >= unverified.size() || !unverified[i]) return true;
+    unverified[i] = 0;
+
+    const ArchiveEntry* e = archive.find(chunk.gridX, chunk.gridZ);
+    if (e && archive.verify(*e)) return true;
+    std::cerr << "Corrupt chunk (" << chunk.gridX << ", " << chunk.gridZ << ") in " << archive.path()
+              << ", replaced by a flat one" << std::endl;
+    chunk.resetHeightMap();
+    return false;
+}
+
 void TerrainMap::applyBrush(const Brush& b, const glm::vec3& hit, bool lower) {
     // Determine brush bounds in world coords
-    float minX = hit.x - b.radius;
-    float maxX = hit.x + b.radius;
-    float minZ = hit.z - b.radius;
-    float maxZ = hit.z + b.radius;
+    collectBrushTargets(hit.x - b.radius, hit.z - b.radius, hit.x + b.radius, hit.z + b.radius);
 
-    for (auto& chunk : chunks) {
-        // Compute this chunk’s world bounding box
-        float cx0 = chunk->position.x;
-        float cz0 = chunk->position.z;
-        float cx1 = cx0 + (chunk->hm.size - 1) * cellSize;
-        float cz1 = cz0 + (chunk->hm.size - 1) * cellSize;
-
-        // If brush overlaps chunk
-        if (maxX >= cx0 && minX <= cx1 &&
-            maxZ >= cz0 && minZ <= cz1) {
-
-            // Convert hit point to chunk-local coordinates
-            glm::vec3 localHit = hit - chunk->position;
-            chunk->applyBrush(b, localHit, lower);
+    // Chunks only touch their own heightmap and scratch buffers, so they can be brushed
+    // concurrently and the result doesn't depend on scheduling
+    workers.parallelFor((int)brushTargets.size(), [&](int i) {
+        TerrainChunk* chunk = brushTargets[i];
+        // Convert hit point to chunk-local coordinates
+        glm::vec3 localHit = hit - chunk->position;
+        chunk->applyBrush(b, localHit, lower);
+    });
+}
+
+void TerrainMap::applyStroke(const Brush& b, const std::vector<glm::vec3>& dabs, float weight, bool lower) {
+    if (dabs.empty()) return;
+
+    glm::vec3 lo = dabs[0], hi = dabs[0];
+    for (const glm::vec3& d : dabs) { lo = glm::min(lo, d); hi = glm::max(hi, d); }
+    collectBrushTargets(lo.x - b.radius, lo.z - b.radius, hi.x + b.radius, hi.z + b.radius);
+
+    workers.parallelFor((int)brushTargets.size(), [&](int i) {
+        brushTargets[i]->applyDabs(b, dabs, weight, lower);
+    });
+}
+
+void TerrainMap::selectLods(const glm::vec3& camPos, float viewportHeight, float fovY, float maxPixelError) {
+    // Screen pixels covered by one world unit at distance 1
+    const float pixelsPerUnit = viewportHeight / (2.0f * tanf(fovY * 0.5f));
+    const int maxLod = std::min(indices.lodCount(), (int)HeightPyramid::kLodLevels) - 1;
+
+    chunkLod.assign(chunksX * chunksZ, 0);
+    for (int i = 0; i < chunksX * chunksZ; ++i) {
+        TerrainChunk* chunk = chunkGrid[i];
+        if (!chunk) continue;
+        const HeightPyramid& pyr = chunk->heightPyramid();
+        glm::vec3 bmin, bmax;
+        chunk->bounds(bmin, bmax);
+        float dist = glm::length(glm::clamp(camPos, bmin, bmax) - camPos);
+
+        // Coarsest level whose worst-case error projects to no more than maxPixelError
+        for (int l = maxLod; l > 0; --l) {
+            if (pyr.lodError(l) * pixelsPerUnit <= maxPixelError * dist) { chunkLod[i] = l; break; }
+        }
+    }
+
+    // Neighbours may differ by at most one level, which is all a snapped border ring can stitch
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int gz = 0; gz < chunksZ; ++gz) {
+            for (int gx = 0; gx < chunksX; ++gx) {
+                int i = gz * chunksX + gx;
+                if (!chunkGrid[i]) continue;
+                const int nb[4][2] = {{gx-1,gz}, {gx+1,gz}, {gx,gz-1}, {gx,gz+1}};
+                for (auto& n : nb) {
+                    if (n[0] < 0 || n[1] < 0 || n[0] >= chunksX || n[1] >= chunksZ) continue;
+                    int j = n[1] * chunksX + n[0];
+                    if (chunkGrid[j] && chunkLod[i] > chunkLod[j] + 1) { chunkLod[i] = chunkLod[j] + 1; changed = true; }
+                }
+            }
+        }
+    }
+
+    for (int gz = 0; gz < chunksZ; ++gz) {
+        for (int gx = 0; gx < chunksX; ++gx) {
+            int i = gz * chunksX + gx;
+            if (!chunkGrid[i]) continue;
+            auto coarser = [&](int nx, int nz) {
+                if (nx < 0 || nz < 0 || nx >= chunksX || nz >= chunksZ) return false;
+                int j = nz * chunksX + nx;
+                return chunkGrid[j] && chunkLod[j] > chunkLod[i];
+            };
+            int mask = 0;
+            if (coarser(gx-1, gz)) mask |= TerrainIndexBuffer::EdgeNegX;
+            if (coarser(gx+1, gz)) mask |= TerrainIndexBuffer::EdgePosX;
+            if (coarser(gx, gz-1)) mask |= TerrainIndexBuffer::EdgeNegZ;
+            if (coarser(gx, gz+1)) mask |= TerrainIndexBuffer::EdgePosZ;
+            chunkGrid[i]->setLod(chunkLod[i], mask);
         }
     }
 }
 
-void TerrainMap::render(bool wire) {
-    for (auto& chunk : chunks) {
-        chunk->Render(wire);
+void TerrainMap::resetLods() {
+    for (auto& chunk : chunks) chunk->setLod(0, 0);
+}
+
+void TerrainMap::render(Shader& shader, const Frustum* frustum) {
+    // The COMPACT_VERTEX/HEIGHT_TEXTURE hmap.vs permutations rebuild X/Z/UV from gl_VertexID and these
+    if (renderMode != TerrainRenderMode::FullVertex) {
+        shader.setFloat("uCellSize", cellSize);
+        shader.setInt("uGridSize", chunkSize);
+        shader.setInt("uChunksX", chunksX);
+    }
+    if (renderMode == TerrainRenderMode::HeightTexture) shader.setInt("uHeightTex", 0);
+
+    drawCounts.clear();
+    drawOffsets.clear();
+    drawBases.clear();
+    drawnTriangles = 0;
+    visibleChunks = culledChunks = 0;
+    for (int i = 0; i < chunksX * chunksZ; ++i) {
+        TerrainChunk* chunk = chunkGrid[i];
+        // Only chunks built into slot i of this arena; anything else would draw another chunk's
+        // vertices or read past the end of the arena
+        if (!chunk || chunk->meshArena() != &arena || chunk->arenaSlot() != i) continue;
+        if (frustum) {
+            glm::vec3 bmin, bmax;
+            chunk->bounds(bmin, bmax);
+            if (!frustum->intersectsBox(bmin, bmax)) { ++culledChunks; continue; }
+        }
+        ++visibleChunks;
+        // Never draw a slot before its first upload (a no-op if updateDirtyChunks already ran)
+        chunk->updateMeshIfDirty();
+        indices.appendDraw(chunk->lodLevel(), chunk->lodStitchMask(), drawCounts, drawOffsets);
+        drawBases.resize(drawCounts.size(), arena.baseVertex(i));
+        drawnTriangles += indices.triangleCount(chunk->lodLevel(), chunk->lodStitchMask());
     }
+
+    // Wireframe is the WIREFRAME permutation of the bound program (an overlay in hmap.fs), so it's the same single draw
+    arena.draw(drawCounts, drawOffsets, drawBases);
 }
 
 std::vector<std::unique_ptr<TerrainChunk>>& TerrainMap::GetChunks()
@@ -64,43 +209,206 @@ std::vector<std::unique_ptr<TerrainChunk>>& TerrainMap::GetChunks()
     return chunks;
 }
 
-// TerrainChunk* TerrainMap::getChunkAt(glm::vec3 worldPos) {
-//     int cx = int(worldPos.x / ((chunkSize-1) * cellSize));
-//     int cz = int(worldPos.z / ((chunkSize-1) * cellSize));
-//     if (cx < 0 || cz < 0 || cx >= chunksX || cz >= chunksZ) return nullptr;
-//     // return &chunks[cz * chunksX + cx];
-//     return chunks[cz * chunksX + cx].get();
-// }
+TerrainChunk* TerrainMap::getChunkAtGrid(int gx, int gz) {
+    if (gx < 0 || gz < 0 || gx >= chunksX || gz >= chunksZ) return nullptr;
+    return chunkGrid[gz * chunksX + gx];
+}
 
+// Chunks overlap by one sample, so each owns [origin, origin + (chunkSize-1)*cellSize)
 TerrainChunk* TerrainMap::getChunkAt(const glm::vec3& worldPos) {
-    for (auto& chunkPtr : chunks) {
-        if (chunkPtr->contains(worldPos.x, worldPos.z)) {
-            return chunkPtr.get();
-        }
-    }
-    return nullptr;
+    float span = (chunkSize - 1) * cellSize;
+    return getChunkAtGrid((int)floorf(worldPos.x / span), (int)floorf(worldPos.z / span));
 }
 
-void TerrainMap::updateDirtyChunks()
+void TerrainMap::updateDirtyChunks(const Frustum* frustum)
 {   
     for (auto& chunk : chunks) {
+        if (frustum) {
+            glm::vec3 bmin, bmax;
+            chunk->bounds(bmin, bmax);
+            if (!frustum->intersectsBox(bmin, bmax)) continue;
+        }
         chunk->updateMeshIfDirty();
     }
 }
 
 
 float TerrainMap::getHeightGlobal(float x, float z) {
-    for (auto& chunkPtr : chunks) {
-        if (chunkPtr->contains(x, z)) {
-            glm::vec3 local = glm::vec3(x, 0, z) - chunkPtr->position;
-            return chunkPtr->getHeightAt(local.x, local.z);
+    TerrainChunk* chunk = getChunkAt(glm::vec3(x, 0, z));
+    if (!chunk) return -1.0f;
+    glm::vec3 local = glm::vec3(x, 0, z) - chunk->position;
+    return chunk->getHeightAt(local.x, local.z);
+}
+
+
+// Extent of the map footprint used to clip rays; heights are only known per chunk, so Y is open
+static void mapBounds(int chunksX, int chunksZ, float span, glm::vec3& bmin, glm::vec3& bmax) {
+    const float big = std::numeric_limits<float>::max();
+    bmin = glm::vec3(0.0f, -big, 0.0f);
+    bmax = glm::vec3(chunksX * span, big, chunksZ * span);
+}
+
+bool TerrainMap::raycast(const glm::vec3& ro, const glm::vec3& rd, float maxDist, glm::vec3& outHit, PickStats* stats) {
+    const float span = (chunkSize - 1) * cellSize;
+    glm::vec3 invRd(1.0f / rd.x, 1.0f / rd.y, 1.0f / rd.z);
+
+    glm::vec3 bmin, bmax;
+    mapBounds(chunksX, chunksZ, span, bmin, bmax);
+    float tEnter, tExit;
+    if (!rayBox(ro, invRd, bmin, bmax, 0.0f, maxDist, tEnter, tExit)) return false;
+    return walkChunks(ro, rd, invRd, tEnter, tExit, outHit, stats);
+}
+
+bool TerrainMap::walkChunks(const glm::vec3& ro, const glm::vec3& rd, const glm::vec3& invRd,
+                            float tEnter, float tExit, glm::vec3& outHit, PickStats* stats, bool skipEntry) {
+    const float span = (chunkSize - 1) * cellSize;
+    const float pad = 1e-3f;
+    const float inf = std::numeric_limits<float>::infinity();
+
+    glm::vec3 p = ro + rd * tEnter;
+    int gx = glm::clamp((int)floorf(p.x / span), 0, chunksX - 1);
+    int gz = glm::clamp((int)floorf(p.z / span), 0, chunksZ - 1);
+
+    // 2D DDA over the chunk grid, same stepping as TerrainChunk::rayGridIntersect
+    int stepX = rd.x > 0 ? 1 : -1, stepZ = rd.z > 0 ? 1 : -1;
+    float tDeltaX = rd.x != 0 ? span / fabsf(rd.x) : inf;
+    float tDeltaZ = rd.z != 0 ? span / fabsf(rd.z) : inf;
+    float tMaxX = rd.x != 0 ? ((gx + (rd.x > 0 ? 1 : 0)) * span - ro.x) / rd.x : inf;
+    float tMaxZ = rd.z != 0 ? ((gz + (rd.z > 0 ? 1 : 0)) * span - ro.z) / rd.z : inf;
+
+    float t0 = tEnter;
+    for (;;) {
+        float t1 = std::min(std::min(tMaxX, tMaxZ), tExit);
+
+        TerrainChunk* chunk = skipEntry ? nullptr : getChunkAtGrid(gx, gz);
+        skipEntry = false;
+        if (chunk) {
+            if (stats) ++stats->chunksVisited;
+            // Skip chunks whose height range the ray passes over/under inside this column
+            glm::vec3 localRo = ro - chunk->position;
+            const HeightPyramid& pyr = chunk->heightPyramid();
+            float a, b;
+            if (rayBox(localRo, invRd, glm::vec3(-pad, pyr.minHeight() - pad, -pad),
+                       glm::vec3(span + pad, pyr.maxHeight() + pad, span + pad), t0 - pad, t1 + pad, a, b)) {
+                glm::vec3 localHit;
+                // Hits in this column come before anything in later columns, so the first one wins
+                if (chunk->rayHeightmapIntersect(localRo, rd, t1 + pad, localHit, stats)) {
+                    outHit = localHit + chunk->position;
+                    return true;
+                }
+            }
         }
+
+        if (t1 >= tExit) return false;
+        if (tMaxX < tMaxZ) { gx += stepX; t0 = tMaxX; tMaxX += tDeltaX; }
+        else               { gz += stepZ; t0 = tMaxZ; tMaxZ += tDeltaZ; }
+        if (gx < 0 || gz < 0 || gx >= chunksX || gz >= chunksZ) return false;
     }
-    return -1.0f;
 }
 
+void TerrainMap::raycastBatch(const std::vector<glm::vec3>& origins, const std::vector<glm::vec3>& dirs,
+                              float maxDist, std::vector<RayHit>& outHits) {
+    const int count = (int)std::min(origins.size(), dirs.size());
+    outHits.assign(count, RayHit());
+    if (count == 0) return;
+
+    const float span = (chunkSize - 1) * cellSize;
+    glm::vec3 bmin, bmax;
+    mapBounds(chunksX, chunksZ, span, bmin, bmax);
+
+    batchEnter.resize(count);
+    batchExit.resize(count);
+    batchKey.resize(count);
+
+    // 1) Clip four rays at a time against the map footprint and key each survivor by the chunk it enters
+    const int packets = (count + 3) / 4;
+    const int packetTasks = (packets + kPacketsPerTask - 1) / kPacketsPerTask;
+    workers.parallelFor(packetTasks, [&](int task) {
+        int pEnd = std::min(packets, (task + 1) * kPacketsPerTask);
+        for (int p = task * kPacketsPerTask; p < pEnd; ++p) {
+            RayPacket4 pk;
+            for (int lane = 0; lane < 4; ++lane) {
+                int r = std::min(p * 4 + lane, count - 1); // tail lanes repeat the last ray
+                pk.ox[lane] = origins[r].x; pk.oy[lane] = origins[r].y; pk.oz[lane] = origins[r].z;
+                pk.ix[lane] = 1.0f / dirs[r].x; pk.iy[lane] = 1.0f / dirs[r].y; pk.iz[lane] = 1.0f / dirs[r].z;
+            }
+            float tEnter[4], tExit[4];
+            int mask = rayBox4(pk, bmin, bmax, 0.0f, maxDist, tEnter, tExit);
+            for (int lane = 0; lane < 4 && p * 4 + lane < count; ++lane) {
+                int r = p * 4 + lane;
+                if (!(mask & (1 << lane))) { batchKey[r] = -1; continue; }
+                glm::vec3 e = origins[r] + dirs[r] * tEnter[lane];
+                int gx = glm::clamp((int)floorf(e.x / span), 0, chunksX - 1);
+                int gz = glm::clamp((int)floorf(e.z / span), 0, chunksZ - 1);
+                batchKey[r] = gz * chunksX + gx;
+                batchEnter[r] = tEnter[lane];
+                batchExit[r] = tExit[lane];
+            }
+        }
+    });
+
+    // 2) Counting sort by entry chunk so each task walks rays that start in the same pyramid
+    const int cells = chunksX * chunksZ;
+    batchStart.assign(cells + 1, 0);
+    for (int r = 0; r < count; ++r)
+        if (batchKey[r] >= 0) ++batchStart[batchKey[r] + 1];
+    for (int c = 0; c < cells; ++c) batchStart[c + 1] += batchStart[c];
+    const int live = batchStart[cells];
+    batchOrder.resize(live);
+    for (int r = 0; r < count; ++r)
+        if (batchKey[r] >= 0) batchOrder[batchStart[batchKey[r]]++] = r;
+
+    // 3) Trace the survivors in sorted order, a block of rays per task. Up to four consecutive rays
+    //    share an entry chunk, so they test its pyramid box as one packet; lanes that can't hit
+    //    there skip straight to the chunk walk from the next chunk on.
+    const float pad = 1e-3f;
+    const int traceTasks = (live + kRaysPerTask - 1) / kRaysPerTask;
+    workers.parallelFor(traceTasks, [&](int task) {
+        int iEnd = std::min(live, (task + 1) * kRaysPerTask);
+        for (int i = task * kRaysPerTask; i < iEnd; ) {
+            const int key = batchKey[batchOrder[i]];
+            int lanes = 1;
+            while (lanes < 4 && i + lanes < iEnd && batchKey[batchOrder[i + lanes]] == key) ++lanes;
+
+            TerrainChunk* chunk = chunkGrid[key];
+            float boxEnter[4], boxExit[4];
+            int mask = 0;
+            if (chunk) {
+                RayPacket4 pk;
+                for (int lane = 0; lane < 4; ++lane) {
+                    int r = batchOrder[i + std::min(lane, lanes - 1)]; // tail lanes repeat the last ray
+                    glm::vec3 lo = origins[r] - chunk->position;
+                    pk.ox[lane] = lo.x; pk.oy[lane] = lo.y; pk.oz[lane] = lo.z;
+                    pk.ix[lane] = 1.0f / dirs[r].x; pk.iy[lane] = 1.0f / dirs[r].y; pk.iz[lane] = 1.0f / dirs[r].z;
+                }
+                const HeightPyramid& pyr = chunk->heightPyramid();
+                // The box is the chunk's column, so it clips each lane to the entry chunk by itself
+                mask = rayBox4(pk, glm::vec3(-pad, pyr.minHeight() - pad, -pad),
+                               glm::vec3(span + pad, pyr.maxHeight() + pad, span + pad), 0.0f, maxDist, boxEnter, boxExit);
+            }
 
-void TerrainMap::save(const std::string& folderPath) {
+            for (int lane = 0; lane < lanes; ++lane) {
+                int r = batchOrder[i + lane];
+                const glm::vec3& ro = origins[r];
+                const glm::vec3& rd = dirs[r];
+                RayHit& h = outHits[r];
+                glm::vec3 localHit;
+                if ((mask & (1 << lane)) &&
+                    chunk->rayHeightmapIntersect(ro - chunk->position, rd, boxExit[lane] + pad, localHit)) {
+                    h.hit = true;
+                    h.position = localHit + chunk->position;
+                } else {
+                    glm::vec3 invRd(1.0f / rd.x, 1.0f / rd.y, 1.0f / rd.z);
+                    h.hit = walkChunks(ro, rd, invRd, batchEnter[r], batchExit[r], h.position, nullptr, true);
+                }
+                if (h.hit) h.distance = glm::length(h.position - ro);
+            }
+            i += lanes;
+        }
+    });
+}
+
+void TerrainMap::exportFolder(const std::string& folderPath) {
     namespace fs = std::filesystem;
 
     // Create the folder if it doesn't exist
@@ -124,15 +432,17 @@ void TerrainMap::save(const std::string& folderPath) {
     std::cout << "TerrainMap saved successfully to " << folderPath << std::endl;
 }
 
-void TerrainMap::load(const std::string& folderPath) {
+void TerrainMap::importFolder(const std::string& folderPath) {
     namespace fs = std::filesystem;
 
     if (!fs::exists(folderPath) || !fs::is_directory(folderPath)) {
         std::cerr << "Folder does not exist: " << folderPath << std::endl;
     }
 
-    // Clear current chunks
+    // Clear current chunks; they no longer match any archive
     chunks.clear();
+    archive.close();
+    unverified.clear();
     int numErrors = 0;
 
     // Iterate over all .hmp files
@@ -145,6 +455,7 @@ void TerrainMap::load(const std::string& folderPath) {
         if (!chunk->loadHMap(entry.path().string())) {
             std::cerr << "Failed to load chunk: " << entry.path() << std::endl;
             numErrors++;
+            continue;
         }
 
         chunks.push_back(std::move(chunk));
@@ -162,14 +473,122 @@ void TerrainMap::load(const std::string& folderPath) {
         chunksZ = maxZ + 1;
     }
 
+    // directory_iterator hands chunks back in arbitrary order, so index them by grid coords
+    rebuildGridIndex();
+
+    // The arena still holds the previous world's slots, so rebuild it for whatever did load;
+    // chunks upload once they come into view
+    build();
+
     if(numErrors > 0){
         std::cout << "TerrainMap failed to load " << numErrors << " chunks from: " << folderPath << std::endl;
     }
     else {
-        build();
-        updateDirtyChunks();
         std::cout << "TerrainMap loaded successfully from " << folderPath << std::endl;
     }
 }
-// Optionally, update chunksX and chunksZ based on loaded data
-// Update chunksX/Z
\ No newline at end of file
+
+bool TerrainMap::save(const std::string& archivePath) {
+    size_t chunkBytes = (size_t)chunkSize * chunkSize * sizeof(float);
+    const ArchiveHeader& hdr = archive.header();
+    bool sameWorld = archive.isOpen() && archive.path() == archivePath &&
+                     (int)hdr.chunkSize == chunkSize && hdr.cellSize == cellSize &&
+                     (int)hdr.chunksX == chunksX && (int)hdr.chunksZ == chunksZ;
+    size_t editedCount = 0;
+    for (auto& chunk : chunks) if (chunk->hasUnsavedEdits()) ++editedCount;
+    // Appending forever would grow the file without bound, so compact once half of it is dead
+    bool compact = hdr.deadBytes + editedCount * chunkBytes > chunks.size() * chunkBytes;
+    bool rewrite = !sameWorld || compact;
+
+    // A rewrite copies every chunk under a new checksum, so check the ones nobody brushed yet
+    if (rewrite) for (auto& chunk : chunks) verifyChunk(*chunk);
+
+#ifdef _WIN32
+    // Windows won't replace a file that is still mapped. Copy the heights out before the lists
+    // below take pointers to them, since own() moves them.
+    if (rewrite) for (auto& chunk : chunks) chunk->hm.own();
+#endif
+
+    std::vector<ArchiveChunk> all, edited;
+    for (auto& chunk : chunks) {
+        ArchiveChunk c{chunk->gridX, chunk->gridZ, chunk->hm.data, chunk->hm.count()};
+        all.push_back(c);
+        if (chunk->hasUnsavedEdits()) edited.push_back(c);
+    }
+
+    const std::vector<ArchiveChunk>* written = &edited;
+    bool ok;
+    if (!rewrite) {
+        if (edited.empty()) { std::cout << "No edited chunks to save" << std::endl; return true; }
+        ok = archive.append(edited);
+    }
+    else {
+        ok = archive.writeAll(archivePath, chunkSize, cellSize, chunksX, chunksZ, all);
+        written = &all;
+    }
+    if (!ok) {
+        std::cerr << "Failed to save world archive: " << archivePath << std::endl;
+        return false;
+    }
+
+    // View the payloads just written, which releases the copy-on-write pages the edits made
+    for (const ArchiveChunk& c : *written) {
+        TerrainChunk* chunk = getChunkAtGrid(c.gridX, c.gridZ);
+        const ArchiveEntry* e = archive.find(c.gridX, c.gridZ);
+        if (!chunk || !e) continue;
+        chunk->hm.view(archive.mapping(), (size_t)e->offset);
+        chunk->markSaved();
+    }
+
+    std::cout << "TerrainMap saved " << written->size() << " chunks to " << archivePath << std::endl;
+    return true;
+}
+
+bool TerrainMap::load(const std::string& archivePath, bool verifyAll) {
+    // The previous archive is gone either way, so nothing is left to check the current chunks against
+    unverified.clear();
+    if (!archive.open(archivePath)) {
+        std::cerr << "Failed to open world archive: " << archivePath << std::endl;
+        return false;
+    }
+    const ArchiveHeader& hdr = archive.header();
+    if ((int)hdr.chunkSize != chunkSize || hdr.cellSize != cellSize) {
+        std::cerr << "Mismatched chunk size in world archive: " << archivePath << std::endl;
+        archive.close();
+        return false;
+    }
+
+    // Clear current chunks
+    chunks.clear();
+    chunksX = (int)hdr.chunksX;
+    chunksZ = (int)hdr.chunksZ;
+    int numErrors = 0;
+    // Hashing every payload would read the whole world before anything is shown
+    unverified.assign((size_t)chunksX * chunksZ, verifyAll ? 0 : 1);
+
+    // Straight from the index, no directory scan
+    for (const ArchiveEntry& e : archive.entries()) {
+        auto chunk = std::make_unique<TerrainChunk>(chunkSize, cellSize);
+        if (e.codec != (uint32_t)ChunkCodec::RawF32 || e.size != chunk->hm.count() * sizeof(float) ||
+            (verifyAll && !archive.verify(e))) {
+            // Keep the grid complete with a flat chunk; it is written back on the next save
+            std::cerr << "Corrupt chunk (" << e.gridX << ", " << e.gridZ << ") in " << archivePath << std::endl;
+            chunk->gridX = e.gridX;
+            chunk->gridZ = e.gridZ;
+            chunk->position = {e.gridX * (chunkSize - 1) * cellSize, 0.0f, e.gridZ * (chunkSize - 1) * cellSize};
+            unverified[(size_t)e.gridZ * chunksX + e.gridX] = 0;
+            numErrors++;
+        }
+        else chunk->viewHeights(archive.mapping(), (size_t)e.offset, e.gridX, e.gridZ);
+        chunks.push_back(std::move(chunk));
+    }
+
+    rebuildGridIndex();
+    build();
+
+    if (numErrors > 0)
+        std::cout << "TerrainMap loaded " << archivePath << " with " << numErrors << " corrupt chunks" << std::endl;
+    else
+        std::cout << "TerrainMap loaded successfully from " << archivePath << std::endl;
+    return numErrors == 0;
+}
@@ -0,0 +1,233 @@
+#include "WorldArchive.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// FNV-1a, same hash the shader uniform table uses; plenty to catch torn or truncated writes
+uint32_t WorldArchive::checksum(const void* data, size_t bytes)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < bytes; ++i) { h ^= p[i]; h *= 16777619u; }
+    return h;
+}
+
+// fstream::flush only hands the bytes to the OS; this waits until they are on disk. Both calls
+// flush the whole file, whichever handle wrote it.
+static bool syncToDisk(const std::string& path)
+{
+#ifdef _WIN32
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    bool ok = FlushFileBuffers(h) != 0;
+    CloseHandle(h);
+#else
+    int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+#endif
+    if (!ok) std::cerr << "Failed to sync " << path << " to disk\n";
+    return ok;
+}
+
+// Zero-fills up to the next page boundary and returns the new position
+static uint64_t padToPage(std::ostream& f, uint64_t pos)
+{
+    static const char zeros[kArchivePageSize] = {};
+    uint64_t aligned = (pos + kArchivePageSize - 1) / kArchivePageSize * kArchivePageSize;
+    f.write(zeros, (std::streamsize)(aligned - pos));
+    return aligned;
+}
+
+// Writes each chunk page-aligned from pos on, replacing or adding its index entry. Returns the
+// end position; bytes of replaced entries are added to dead.
+static uint64_t writePayloads(std::ostream& f, uint64_t pos, const std::vector<ArchiveChunk>& chunks,
+                              std::vector<ArchiveEntry>& index, std::unordered_map<uint64_t, size_t>& lookup,
+                              uint64_t& dead)
+{
+    for (const ArchiveChunk& c : chunks) {
+        pos = padToPage(f, pos);
+        ArchiveEntry e;
+        e.gridX = c.gridX;
+        e.gridZ = c.gridZ;
+        e.offset = pos;
+        e.size = c.count * sizeof(float);
+        e.codec = (uint32_t)ChunkCodec::RawF32;
+        e.checksum = WorldArchive::checksum(c.heights, e.size);
+        f.write((const char*)c.heights, (std::streamsize)e.size);
+        pos += e.size;
+
+        uint64_t k = ((uint64_t)(uint32_t)c.gridZ << 32) | (uint32_t)c.gridX;
+        auto it = lookup.find(k);
+        if (it != lookup.end()) { dead += index[it->second].size; index[it->second] = e; }
+        else { lookup[k] = index.size(); index.push_back(e); }
+    }
+    return pos;
+}
+
+bool WorldArchive::open(const std::string& path)
+{
+    close();
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+
+    ArchiveHeader h;
+    f.read((char*)&h, sizeof(h));
+    if (!f || std::memcmp(h.magic, "TWA1", 4) != 0) { std::cerr << "Not a world archive: " << path << "\n"; return false; }
+    if (h.version != kArchiveVersion) { std::cerr << "Unsupported world archive version " << h.version << "\n"; return false; }
+
+    // Nothing in the header is trusted until it has been checked against the file
+    f.seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)f.tellg();
+    if (h.chunksX < 1 || h.chunksZ < 1 || h.chunksX > kArchiveMaxGrid || h.chunksZ > kArchiveMaxGrid) {
+        std::cerr << "Bad grid size " << h.chunksX << "x" << h.chunksZ << " in " << path << "\n";
+        return false;
+    }
+    if (h.indexOffset > fileSize || h.indexCount > (fileSize - h.indexOffset) / sizeof(ArchiveEntry)) {
+        std::cerr << "Chunk index lies outside " << path << "\n";
+        return false;
+    }
+
+    std::vector<ArchiveEntry> entries(h.indexCount);
+    f.seekg((std::streamoff)h.indexOffset);
+    f.read((char*)entries.data(), (std::streamsize)(entries.size() * sizeof(ArchiveEntry)));
+    if (!f || checksum(entries.data(), entries.size() * sizeof(ArchiveEntry)) != h.indexChecksum) {
+        std::cerr << "Corrupt chunk index in " << path << "\n";
+        return false;
+    }
+
+    auto mapped = std::make_shared<MappedFile>();
+    if (!mapped->open(path)) return false;
+    uint64_t size = mapped->size();
+    for (const ArchiveEntry& e : entries) {
+        if (e.gridX < 0 || e.gridZ < 0 || e.gridX >= (int32_t)h.chunksX || e.gridZ >= (int32_t)h.chunksZ ||
+            e.offset % kArchivePageSize != 0 || e.offset > size || e.size > size - e.offset) {
+            std::cerr << "Chunk (" << e.gridX << ", " << e.gridZ << ") lies outside " << path << "\n";
+            return false;
+        }
+    }
+
+    filePath = path;
+    hdr = h;
+    index = std::move(entries);
+    file = std::move(mapped);
+    rebuildLookup();
+    return true;
+}
+
+void WorldArchive::close()
+{
+    filePath.clear();
+    hdr = {};
+    index.clear();
+    lookup.clear();
+    file.reset();
+}
+
+void WorldArchive::rebuildLookup()
+{
+    lookup.clear();
+    for (size_t i = 0; i < index.size(); ++i) lookup[key(index[i].gridX, index[i].gridZ)] = i;
+}
+
+const ArchiveEntry* WorldArchive::find(int gridX, int gridZ) const
+{
+    auto it = lookup.find(key(gridX, gridZ));
+    return it == lookup.end() ? nullptr : &index[it->second];
+}
+
+bool WorldArchive::verify(const ArchiveEntry& e) const
+{
+    if (!file || e.offset > file->size() || e.size > file->size() - e.offset) return false;
+    return checksum(file->data() + e.offset, (size_t)e.size) == e.checksum;
+}
+
+bool WorldArchive::writeAll(const std::string& path, int chunkSize, float cellSize, int chunksX, int chunksZ,
+                            const std::vector<ArchiveChunk>& chunks)
+{
+    namespace fs = std::filesystem;
+    ArchiveHeader h = {};
+    h.magic[0]='T'; h.magic[1]='W'; h.magic[2]='A'; h.magic[3]='1';
+    h.version = kArchiveVersion;
+    h.chunkSize = chunkSize;
+    h.cellSize = cellSize;
+    h.chunksX = chunksX;
+    h.chunksZ = chunksZ;
+
+    std::vector<ArchiveEntry> entries;
+    std::unordered_map<uint64_t, size_t> keys;
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f) return false;
+        // Header placeholder, rewritten once the index position is known
+        f.write((const char*)&h, sizeof(h));
+        uint64_t pos = writePayloads(f, sizeof(h), chunks, entries, keys, h.deadBytes);
+
+        h.indexOffset = pos;
+        h.indexCount = (uint32_t)entries.size();
+        h.indexChecksum = checksum(entries.data(), entries.size() * sizeof(ArchiveEntry));
+        f.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(ArchiveEntry)));
+        f.seekp(0);
+        f.write((const char*)&h, sizeof(h));
+        f.flush();
+        // On disk before the rename, or a crash could leave path naming a half-written file
+        if (!f || !syncToDisk(tmpPath)) { f.close(); std::error_code ec; fs::remove(tmpPath, ec); return false; }
+    }
+
+    close();
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        std::cerr << "Failed to replace " << path << ": " << ec.message() << "\n";
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return open(path);
+}
+
+bool WorldArchive::append(const std::vector<ArchiveChunk>& chunks)
+{
+    if (!file) return false;
+    std::fstream f(filePath, std::ios::binary | std::ios::in | std::ios::out);
+    if (!f) return false;
+
+    // New index and header are built on copies, so a failed write leaves this object as it was
+    ArchiveHeader h = hdr;
+    std::vector<ArchiveEntry> entries = index;
+    std::unordered_map<uint64_t, size_t> keys = lookup;
+
+    f.seekp(0, std::ios::end);
+    uint64_t pos = writePayloads(f, (uint64_t)f.tellp(), chunks, entries, keys, h.deadBytes);
+
+    h.deadBytes += (uint64_t)h.indexCount * sizeof(ArchiveEntry);
+    h.indexOffset = pos;
+    h.indexCount = (uint32_t)entries.size();
+    h.indexChecksum = checksum(entries.data(), entries.size() * sizeof(ArchiveEntry));
+    f.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(ArchiveEntry)));
+    // Everything the new header points at must be on disk before the header itself
+    f.flush();
+    if (!f || !syncToDisk(filePath)) { std::cerr << "Failed to append to " << filePath << "\n"; return false; }
+
+    f.seekp(0);
+    f.write((const char*)&h, sizeof(h));
+    f.flush();
+    if (!f || !syncToDisk(filePath)) { std::cerr << "Failed to update the header of " << filePath << "\n"; return false; }
+    f.close();
+
+    // Remap so the appended payloads are reachable; views of the old mapping keep it alive
+    std::string path = filePath;
+    return open(path);
+}
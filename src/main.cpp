@@ -27,22 +27,28 @@
 //   - Left Mouse: sculpt (raise). Hold Shift+Left: lower. Middle Mouse: smooth
 //   - Mouse Wheel: change brush radius
 //   - [ / ] : change brush strength
-//   - F5: Save "tile.hmap"   F9: Load "tile.hmap"
+//   - F5: Save "world.twa"   F9: Load "world.twa"
+//   - Shift+F5 / Shift+F9: export / import the "saved" folder, one .hmap per chunk
 //   - F: toggle wireframe
 //   - R: reset heights to 0
 //
-// File format (tile.hmap):
-//   struct Header { char magic[4] = "HMP1"; uint32_t size; float cellSize; }
-//   followed by size*size floats (row-major)
+// File format (chunk_X_Z.hmap):
+//   struct Header { char magic[4] = "HMP2"; uint32_t size; float cellSize; uint32_t gridX, gridZ, pyramidBytes;
+//                   uint64_t payloadOffset; uint64_t payloadBytes; }
+//   the coarse min/max pyramid levels (pyramidBytes), zero padding, then size*size floats (row-major)
+//   at payloadOffset (4096), so the file maps in place.
+//   HMP1 (20-byte header, floats straight after) is still loaded.
 
 // Linux compile:
-// c++ src/*.cpp lib/build/linux/*.o -I lib/include -lSDL2 -ldl -o bin/TerrEdit -O2 -DNDEBUG
+// c++ src/*.cpp lib/build/linux/*.o -I lib/include -lSDL2 -ldl -pthread -o bin/TerrEdit -O2 -DNDEBUG
 
 // Windows compile:
 //g++ src/*.cpp lib/include/imgui/*.cpp -I lib/include/ -o bin/TerrEdit.exe -lSDL2 -lopengl32 -lgdi32 -lwinmm -luser32 -mwindows -O2 -DNDEBUG
 
 //g++ src/*.cpp lib/build/win/*.o -I lib/include/ -lSDL2 -lopengl32 -lgdi32 -lwinmm -luser32 -mwindows -O2 -o bin/TerrEdit.exe
 
+// Brush kernels use SSE2 by default on x86-64; add -mavx2 to either command for the 8-wide path.
+
 #include "Engine.h"
 
 // int main(int argc, char** argv){